@@ -0,0 +1,114 @@
+/*
+    Z80 Emulator - benchmark of the execution engines
+
+    benchZ80() loads a small program into the ROM and runs it with every
+    engine of z80fast.c for the same number of T states:
+
+        step        stepZ80() called once per instruction
+        switch      runZ80Switch(), one central switch on the opcode
+        threaded    runZ80() built with Z80_THREADED, computed goto
+        block       runZ80Block(), decoded blocks from the block cache
+        jit         runZ80Block() with the translation of hot blocks
+
+    The program is a mix of loads, 8 and 16 bit arithmetic, a DJNZ loop,
+    CALL/RET with PUSH/POP and an IX instruction:
+
+        0000  31 00 00      LD SP,0000h
+        0003  21 00 80      LD HL,8000h
+        0006  06 10         LD B,10h
+        0008  7E            LD A,(HL)
+        0009  C6 03         ADD A,03h
+        000B  77            LD (HL),A
+        000C  23            INC HL
+        000D  CB 3F         SRL A
+        000F  A8            XOR B
+        0010  10 F6         DJNZ 0008h
+        0012  CD 20 00      CALL 0020h
+        0015  DD 21 00 90   LD IX,9000h
+        0019  DD 77 05      LD (IX+05h),A
+        001C  C3 06 00      JP 0006h
+        0020  E5            PUSH HL
+        0021  D5            PUSH DE
+        0022  EB            EX DE,HL
+        0023  ED 52         SBC HL,DE
+        0025  D1            POP DE
+        0026  E1            POP HL
+        0027  C9            RET
+
+    The ROM and the registers are overwritten, run it instead of a program.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "z80.h"
+
+#define BENCH_CLOCKS    1000000000UL    // T states for every engine, 250 s of a 4 MHz Z80
+#define BENCH_SLICE     20000           // T states per call, less than 65536 instructions
+
+static const uint8_t benchCode[] = {
+    0x31, 0x00, 0x00, 0x21, 0x00, 0x80, 0x06, 0x10, 0x7E, 0xC6, 0x03, 0x77, 0x23, 0xCB, 0x3F, 0xA8,
+    0x10, 0xF6, 0xCD, 0x20, 0x00, 0xDD, 0x21, 0x00, 0x90, 0xDD, 0x77, 0x05, 0xC3, 0x06, 0x00, 0x00,
+    0xE5, 0xD5, 0xEB, 0xED, 0x52, 0xD1, 0xE1, 0xC9
+};
+
+static const char *benchName[] = { "step", "switch", "threaded", "block", "jit" };
+
+static void benchRun(int engine) {
+    uint64_t clocks = 0;
+    clock_t start;
+    double seconds;
+
+    resetZ80();
+    flushBlocks();
+    memset(&z80.count, 0, sizeof(z80.count));
+
+    start = clock();
+    while (clocks < BENCH_CLOCKS) {
+        if (engine == 0) {
+            uint64_t end = MaxClocks + BENCH_SLICE;
+            while (MaxClocks < end)
+                stepZ80();
+        }
+        else if (engine == 1)
+            runZ80Switch(BENCH_SLICE);
+        else if (engine == 2)
+            runZ80(BENCH_SLICE);
+        else
+            runZ80Block(BENCH_SLICE);      // block and jit
+        clocks = MaxClocks;
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    if (seconds > 0)
+        printf("%-10s %llu instructions, %.3f s, %.2f million instructions/s, %.2f emulated MHz\n",
+               benchName[engine], (unsigned long long)MaxInstrictions, seconds,
+               MaxInstrictions / seconds / 1e6, clocks / seconds / 1e6);
+}
+
+void benchZ80(void) {
+    int debug = Debug;
+    int jit = Jit;
+
+    memset(rom, 0, sizeof(rom));
+    memcpy(rom, benchCode, sizeof(benchCode));
+
+    // no trace output while measuring
+    Debug = 0;
+
+    printf("Benchmark, %lu T states for every engine\n", BENCH_CLOCKS);
+    benchRun(0);
+    benchRun(1);
+#if Z80_THREADED
+    benchRun(2);
+#else
+    printf("%-10s not built, Z80_THREADED is 0\n", benchName[2]);
+#endif
+    Jit = 0;
+    benchRun(3);
+    Jit = 1;
+    benchRun(4);
+    Jit = jit;
+
+    Debug = debug;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Coverage of the executed code
+
+    With -v file the address of every executed instruction is marked in
+    coverMap, one bit per address, with COVER(). That is the only work
+    while the program runs. At the end the opcode and operand bytes of the
+    marked instructions are found with the disassembler and the file gets
+    the z80cover maps:
+
+        start       an instruction was executed at the address
+        op          the address is an opcode byte (with the prefixes)
+        arg         the address is an operand byte (n, nn or d)
+
+    file.lst is the listing of the ROM with the executed instructions and
+    the ranges that were never executed. covmerge (tools/covmerge.c) adds
+    the maps of many runs together and prints the listing of the sum.
+*/
+
+int Covering;                           // COVER() is called for every instruction
+
+uint8_t coverMap[8192];
+
+static const char *coverName;
+
+void coverOpen(const char *name) {
+    coverName = name;
+    memset(coverMap, 0, sizeof(coverMap));
+    Covering = 1;
+}
+
+static void coverSet(uint8_t *map, uint16_t addr) {
+    map[addr >> 3] |= (uint8_t)(1 << (addr & 7));
+}
+
+int coverTest(const uint8_t *map, uint16_t addr) {
+    return map[addr >> 3] >> (addr & 7) & 1;
+}
+
+// the opcode and operand bytes of the instructions in cov->start, read with memPeek()
+void coverFill(z80cover *cov) {
+    char text[32];
+
+    for (uint32_t a = 0; a < 65536; a++) {
+        uint16_t pc = (uint16_t)a;
+        if (!coverTest(cov->start, pc))
+            continue;
+        uint8_t b = memPeek(pc);
+        int len = disasmZ80(pc, text, sizeof(text));
+        int ops = 1;
+        if (b == 0xCB || b == 0xED || b == 0xDD || b == 0xFD)
+            ops = 2;
+        for (int i = 0; i < len; i++) {
+            // DDCB d op and FDCB d op, the opcode is after the displacement
+            int opcode = i < ops || (i == 3 && (b == 0xDD || b == 0xFD) && memPeek((uint16_t)(pc + 1)) == 0xCB);
+            coverSet(opcode ? cov->op : cov->arg, (uint16_t)(pc + i));
+        }
+    }
+}
+
+int coverLoad(const char *name, z80cover *cov) {
+    FILE *fd = fopen(name, "rb");
+    int ok;
+
+    if (fd == NULL)
+        return 0;
+    ok = fread(cov, sizeof(*cov), 1, fd) == 1 && cov->magic == COVER_MAGIC;
+    fclose(fd);
+    return ok;
+}
+
+int coverSave(const char *name, const z80cover *cov) {
+    FILE *fd = fopen(name, "wb");
+
+    if (fd == NULL)
+        return 0;
+    int ok = fwrite(cov, sizeof(*cov), 1, fd) == 1;
+    return fclose(fd) == 0 && ok;
+}
+
+// listing of the first len bytes of memory, read with memPeek()
+void coverListing(FILE *fd, const z80cover *cov, uint32_t len) {
+    char text[32];
+    uint32_t code = 0, executed = 0;
+
+    for (uint32_t a = 0; a < len; a++) {
+        code += coverTest(cov->op, (uint16_t)a) || coverTest(cov->arg, (uint16_t)a);
+        executed += coverTest(cov->start, (uint16_t)a);
+    }
+    fprintf(fd, "%u of %u bytes executed (%.1f%%), %u instructions\n\n", code, len,
+            len ? 100.0 * code / len : 0, executed);
+
+    for (uint32_t a = 0; a < len; ) {
+        if (coverTest(cov->start, (uint16_t)a)) {
+            int n = disasmZ80((uint16_t)a, text, sizeof(text));
+            fprintf(fd, "  %04X  ", a);
+            for (int i = 0; i < 4; i++)
+                fprintf(fd, i < n ? "%02X " : "   ", memPeek((uint16_t)(a + i)));
+            fprintf(fd, " %s\n", text);
+            a += n;
+        }
+        else {
+            // the bytes up to the next executed instruction
+            uint32_t from = a;
+            while (a < len && !coverTest(cov->start, (uint16_t)a))
+                a++;
+            fprintf(fd, "! %04X-%04X  never executed, %u bytes\n", from, a - 1, a - from);
+        }
+    }
+}
+
+int coverClose(uint32_t len) {
+    static z80cover cov;
+    int ok;
+
+    if (!Covering)
+        return 1;
+    Covering = 0;
+
+    memset(&cov, 0, sizeof(cov));
+    cov.magic = COVER_MAGIC;
+    memcpy(cov.start, coverMap, sizeof(cov.start));
+    coverFill(&cov);
+    ok = coverSave(coverName, &cov);
+
+    size_t n = strlen(coverName);
+    char *listName = malloc(n + 5);
+    FILE *fd = NULL;
+    if (listName != NULL) {
+        memcpy(listName, coverName, n);
+        memcpy(listName + n, ".lst", 5);
+        fd = fopen(listName, "w");
+    }
+    if (fd != NULL) {
+        coverListing(fd, &cov, len);
+        ok = fclose(fd) == 0 && ok;
+    }
+    else
+        ok = 0;
+    free(listName);
+    return ok;
+}
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "z80.h"
+
+/*
+    Disassembler for the Zilog Z80 Processor.
+
+    The opcode is split in the fields x (bits 7-6), y (bits 5-3), z (bits 2-0),
+    p (bits 5-4) and q (bit 3). The numbers are written like in the test
+    programs, 1Ah and 0BBCCh. Memory is read with memPeek() so the bus is not
+    disturbed.
+*/
+
+static const char *const r8[8] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+static const char *const rp[4] = { "BC", "DE", "HL", "SP" };
+static const char *const rp2[4] = { "BC", "DE", "HL", "AF" };
+static const char *const cc[8] = { "NZ", "Z", "NC", "C", "PO", "PE", "P", "M" };
+static const char *const alu[8] = { "ADD A, ", "ADC A, ", "SUB ", "SBC A, ", "AND ", "XOR ", "OR ", "CP " };
+static const char *const rot[8] = { "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SLL", "SRL" };
+static const char *const acc[8] = { "RLCA", "RRCA", "RLA", "RRA", "DAA", "CPL", "SCF", "CCF" };
+static const char *const im[8] = { "0", "0", "1", "2", "0", "0", "1", "2" };
+static const char *const blk[4][4] = {
+    { "LDI", "CPI", "INI", "OUTI" },
+    { "LDD", "CPD", "IND", "OUTD" },
+    { "LDIR", "CPIR", "INIR", "OTIR" },
+    { "LDDR", "CPDR", "INDR", "OTDR" }
+};
+
+// number in the assembler format, a leading 0 when it starts with a letter
+static void hex8(char *s, uint8_t v) {
+    sprintf(s, (v >> 4) > 9 ? "0%02Xh" : "%02Xh", v);
+}
+
+static void hex16(char *s, uint16_t v) {
+    sprintf(s, (v >> 12) > 9 ? "0%04Xh" : "%04Xh", v);
+}
+
+int disasmZ80(uint16_t pc, char *text, int size) {
+    uint16_t start = pc;
+    uint8_t op = memPeek(pc++);
+    const char *hl = "HL", *h = "H", *l = "L";
+    char m[16] = "(HL)";            // (HL) or (IX+d)
+    char n[8], nn[8];
+    char r[8][16];
+    int x, y, z, p, q, i;
+    int index = 0;
+
+    // DD and FD replace HL with IX or IY
+    if (op == 0xDD || op == 0xFD) {
+        uint8_t next = memPeek(pc);
+        if (next == 0xDD || next == 0xED || next == 0xFD) {
+            snprintf(text, size, "NOP*");
+            return 1;
+        }
+        index = op;
+        hl = (op == 0xDD) ? "IX" : "IY";
+        h = (op == 0xDD) ? "IXH" : "IYH";
+        l = (op == 0xDD) ? "IXL" : "IYL";
+        op = memPeek(pc++);
+    }
+
+    // displacement of (IX+d), in DDCB it comes before the opcode
+    if (index && (op == 0xCB || op == 0x34 || op == 0x35 || op == 0x36
+        || ((op & 0xC0) == 0x40 && ((op & 7) == 6) != ((op & 0x38) == 0x30))
+        || ((op & 0xC0) == 0x80 && (op & 7) == 6))) {
+        int8_t d = (int8_t)memPeek(pc++);
+        snprintf(m, sizeof(m), "(%s%c%02Xh)", hl, d < 0 ? '-' : '+', d < 0 ? -d : d);
+    }
+
+    for (i = 0; i < 8; i++)
+        snprintf(r[i], sizeof(r[i]), "%s", r8[i]);
+    snprintf(r[6], sizeof(r[6]), "%s", m);
+
+    if (op == 0xCB) {
+        op = memPeek(pc++);
+        x = op >> 6; y = (op >> 3) & 7; z = op & 7;
+        if (index && z != 6 && x != 1) {
+            // undocumented, the result is also copied into a register
+            if (x == 0)
+                snprintf(text, size, "%s %s, %s", rot[y], m, r8[z]);
+            else
+                snprintf(text, size, "%s %d, %s, %s", x == 2 ? "RES" : "SET", y, m, r8[z]);
+        }
+        else if (x == 0)
+            snprintf(text, size, "%s %s", rot[y], index ? m : r[z]);
+        else
+            snprintf(text, size, "%s %d, %s", x == 1 ? "BIT" : x == 2 ? "RES" : "SET", y, index ? m : r[z]);
+        return (uint16_t)(pc - start);
+    }
+
+    if (op == 0xED) {
+        op = memPeek(pc++);
+        x = op >> 6; y = (op >> 3) & 7; z = op & 7; p = y >> 1; q = y & 1;
+        if (x == 1) {
+            switch (z) {
+                case 0: snprintf(text, size, y == 6 ? "IN (C)" : "IN %s, (C)", r8[y]); break;
+                case 1: snprintf(text, size, y == 6 ? "OUT (C), 0" : "OUT (C), %s", r8[y]); break;
+                case 2: snprintf(text, size, "%s HL, %s", q ? "ADC" : "SBC", rp[p]); break;
+                case 3:
+                    hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                    pc += 2;
+                    if (q)
+                        snprintf(text, size, "LD %s, (%s)", rp[p], nn);
+                    else
+                        snprintf(text, size, "LD (%s), %s", nn, rp[p]);
+                    break;
+                case 4: snprintf(text, size, "NEG"); break;
+                case 5: snprintf(text, size, y == 1 ? "RETI" : "RETN"); break;
+                case 6: snprintf(text, size, "IM %s", im[y]); break;
+                default: {
+                    static const char *const misc[8] = { "LD I, A", "LD R, A", "LD A, I", "LD A, R", "RRD", "RLD", "NOP*", "NOP*" };
+                    snprintf(text, size, "%s", misc[y]);
+                    break;
+                }
+            }
+        }
+        else if (x == 2 && z <= 3 && y >= 4)
+            snprintf(text, size, "%s", blk[y - 4][z]);
+        else
+            snprintf(text, size, "NOP*");
+        return (uint16_t)(pc - start);
+    }
+
+    if (index) {
+        // H and L are replaced only when (IX+d) is not used by the instruction
+        if (!((op & 0xC0) == 0x40 && ((op & 7) == 6 || (op & 0x38) == 0x30)) && op != 0xEB) {
+            snprintf(r[4], sizeof(r[4]), "%s", h);
+            snprintf(r[5], sizeof(r[5]), "%s", l);
+        }
+        if (op == 0xEB || op == 0xD9)
+            hl = "HL";
+    }
+
+    x = op >> 6; y = (op >> 3) & 7; z = op & 7; p = y >> 1; q = y & 1;
+
+    switch (x) {
+        case 0:
+            switch (z) {
+                case 0:
+                    if (y == 0)
+                        snprintf(text, size, "NOP");
+                    else if (y == 1)
+                        snprintf(text, size, "EX AF, AF'");
+                    else {
+                        hex16(nn, (uint16_t)(pc + 1 + (int8_t)memPeek(pc)));
+                        pc++;
+                        if (y == 2)
+                            snprintf(text, size, "DJNZ %s", nn);
+                        else if (y == 3)
+                            snprintf(text, size, "JR %s", nn);
+                        else
+                            snprintf(text, size, "JR %s, %s", cc[y - 4], nn);
+                    }
+                    break;
+                case 1:
+                    if (q)
+                        snprintf(text, size, "ADD %s, %s", hl, p == 2 ? hl : rp[p]);
+                    else {
+                        hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                        pc += 2;
+                        snprintf(text, size, "LD %s, %s", p == 2 ? hl : rp[p], nn);
+                    }
+                    break;
+                case 2:
+                    if (p < 2)
+                        snprintf(text, size, q ? "LD A, (%s)" : "LD (%s), A", rp[p]);
+                    else {
+                        hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                        pc += 2;
+                        if (p == 2)
+                            snprintf(text, size, q ? "LD %s, (%s)" : "LD (%s), %s", q ? hl : nn, q ? nn : hl);
+                        else
+                            snprintf(text, size, q ? "LD A, (%s)" : "LD (%s), A", nn);
+                    }
+                    break;
+                case 3:
+                    snprintf(text, size, "%s %s", q ? "DEC" : "INC", p == 2 ? hl : rp[p]);
+                    break;
+                case 4:
+                case 5:
+                    snprintf(text, size, "%s %s", z == 4 ? "INC" : "DEC", r[y]);
+                    break;
+                case 6:
+                    hex8(n, memPeek(pc++));
+                    snprintf(text, size, "LD %s, %s", r[y], n);
+                    break;
+                default:
+                    snprintf(text, size, "%s", acc[y]);
+                    break;
+            }
+            break;
+
+        case 1:
+            if (op == 0x76)
+                snprintf(text, size, "HALT");
+            else
+                snprintf(text, size, "LD %s, %s", r[y], r[z]);
+            break;
+
+        case 2:
+            snprintf(text, size, "%s%s", alu[y], r[z]);
+            break;
+
+        default:
+            switch (z) {
+                case 0:
+                    snprintf(text, size, "RET %s", cc[y]);
+                    break;
+                case 1:
+                    if (q == 0)
+                        snprintf(text, size, "POP %s", p == 2 ? hl : rp2[p]);
+                    else if (p == 0)
+                        snprintf(text, size, "RET");
+                    else if (p == 1)
+                        snprintf(text, size, "EXX");
+                    else if (p == 2)
+                        snprintf(text, size, "JP (%s)", hl);
+                    else
+                        snprintf(text, size, "LD SP, %s", hl);
+                    break;
+                case 2:
+                    hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                    pc += 2;
+                    snprintf(text, size, "JP %s, %s", cc[y], nn);
+                    break;
+                case 3:
+                    switch (y) {
+                        case 0:
+                            hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                            pc += 2;
+                            snprintf(text, size, "JP %s", nn);
+                            break;
+                        case 2:
+                            hex8(n, memPeek(pc++));
+                            snprintf(text, size, "OUT (%s), A", n);
+                            break;
+                        case 3:
+                            hex8(n, memPeek(pc++));
+                            snprintf(text, size, "IN A, (%s)", n);
+                            break;
+                        case 4: snprintf(text, size, "EX (SP), %s", hl); break;
+                        case 5: snprintf(text, size, "EX DE, HL"); break;
+                        case 6: snprintf(text, size, "DI"); break;
+                        default: snprintf(text, size, "EI"); break;
+                    }
+                    break;
+                case 4:
+                    hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                    pc += 2;
+                    snprintf(text, size, "CALL %s, %s", cc[y], nn);
+                    break;
+                case 5:
+                    if (q == 0)
+                        snprintf(text, size, "PUSH %s", p == 2 ? hl : rp2[p]);
+                    else {
+                        hex16(nn, (uint16_t)(memPeek(pc) | (memPeek(pc + 1) << 8)));
+                        pc += 2;
+                        snprintf(text, size, "CALL %s", nn);
+                    }
+                    break;
+                case 6:
+                    hex8(n, memPeek(pc++));
+                    snprintf(text, size, "%s%s", alu[y], n);
+                    break;
+                default:
+                    hex8(n, (uint8_t)(y * 8));
+                    snprintf(text, size, "RST %s", n);
+                    break;
+            }
+            break;
+    }
+    return (uint16_t)(pc - start);
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "z80.h"
+
+/*
+    Event scheduler
+
+    A device posts a function that is called when MaxClocks reaches a T
+    state, for example to pull _int low at T state X, with eventPost().
+    The events are kept in a heap ordered by their T state, eventNext is
+    the T state of the first one. The engines only test
+
+        if (MaxClocks >= eventNext)
+            eventRun();
+
+    between two instructions, no device is polled. The run loops of the
+    fast and block engines do not even test that: they run to runStop, the
+    end of the slice or eventNext when it comes first, and eventPost()
+    moves runStop forward when an instruction posts an earlier event. A
+    block that was translated by z80jit.c runs to its end, its events come
+    at the end of the block.
+
+    An event that moves an input pin is posted with the pin as arg, like
+    eventPin() and the timers of interrupt.c do. eventMoves() looks for
+    them, so a HALT ends the emulation only when no posted event can wake
+    the CPU.
+*/
+
+#define EVENT_MAX       64              // events that can be posted at the same time
+
+typedef struct z80event {
+    uint64_t when;              // MaxClocks of the call
+    z80eventfn fn;
+    void *arg;
+    uint32_t value;
+} z80event;
+
+uint64_t eventNext = UINT64_MAX;        // T state of the first event
+uint64_t runStop;                       // the run loops return at this T state
+
+static z80event heap[EVENT_MAX];
+static int count;
+
+static void eventSwap(int a, int b) {
+    z80event e = heap[a];
+    heap[a] = heap[b];
+    heap[b] = e;
+}
+
+static void eventUp(int i) {
+    while (i > 0 && heap[(i - 1) / 2].when > heap[i].when) {
+        eventSwap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void eventDown(int i) {
+    for (;;) {
+        int first = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < count && heap[l].when < heap[first].when)
+            first = l;
+        if (r < count && heap[r].when < heap[first].when)
+            first = r;
+        if (first == i)
+            return;
+        eventSwap(i, first);
+        i = first;
+    }
+}
+
+// fn(arg, value) is called at the end of the instruction at which MaxClocks reaches when
+int eventPost(uint64_t when, z80eventfn fn, void *arg, uint32_t value) {
+    if (count == EVENT_MAX)
+        return 0;
+    heap[count] = (z80event){ when, fn, arg, value };
+    eventUp(count++);
+    eventNext = heap[0].when;
+    if (eventNext < runStop)
+        runStop = eventNext;
+    return 1;
+}
+
+// removes the events of fn with arg
+void eventCancel(z80eventfn fn, void *arg) {
+    int n = 0;
+
+    for (int i = 0; i < count; i++)
+        if (heap[i].fn != fn || heap[i].arg != arg)
+            heap[n++] = heap[i];
+    count = n;
+    for (int i = count / 2 - 1; i >= 0; i--)
+        eventDown(i);
+    eventNext = count ? heap[0].when : UINT64_MAX;
+}
+
+// calls the events that are due, they can post new ones
+void eventRun(void) {
+    while (count && heap[0].when <= MaxClocks) {
+        z80event e = heap[0];
+        heap[0] = heap[--count];
+        eventDown(0);
+        eventNext = count ? heap[0].when : UINT64_MAX;
+        if (DEBUG(9))
+            printf("\n\tEvent at T=%llu", (unsigned long long)e.when);
+        e.fn(e.arg, e.value);
+    }
+}
+
+// an event is posted that moves pin
+int eventMoves(const uint8_t *pin) {
+    for (int i = 0; i < count; i++)
+        if (heap[i].arg == pin)
+            return 1;
+    return 0;
+}
+
+static void eventSetPin(void *pin, uint32_t level) {
+    *(uint8_t *)pin = (uint8_t)level;
+    intCheck();
+}
+
+// sets one of the input pins (_int, _nmi, _wait, _busrq) at T state when
+int eventPin(uint8_t *pin, uint8_t level, uint64_t when) {
+    return eventPost(when, eventSetPin, pin, level);
+}
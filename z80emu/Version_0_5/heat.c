@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Heat map of the memory and I/O accesses
+
+    With -a file the fetches, reads and writes of every 256 byte region of
+    memory and the reads and writes of every I/O port (the low byte of the
+    port address) are counted in heatMem and heatIo. The half clock engine
+    counts them in countBus() of main() at the start of every memory cycle
+    of the bus, _M1 tells a fetch from a read. The instruction level engine
+    counts the opcode bytes as fetches and the operand bytes as reads in
+    heatInsn(), memRead(), memWrite(), ioRead() and ioWrite() count the
+    data.
+
+    At the end file gets the counters as CSV, one line per region and port:
+
+        type,number,fetch,read,write
+
+    with type mem and the first address of the region, or io and the port.
+    file.ppm is a picture of 512 x 256 pixels, the memory on the left and
+    the I/O ports on the right, 16 x 16 cells of 16 x 16 pixels with 4 KB
+    of memory in every row of cells. Red are the writes, green the reads
+    and blue the fetches, on a logarithmic scale from 0 to the highest
+    counter of the picture.
+*/
+
+#define HEAT_CELL       16              // pixels of a cell of the picture
+
+int Heating;                            // the accesses are counted
+
+uint64_t heatMem[HEAT_KINDS][256];
+uint64_t heatIo[HEAT_KINDS][256];
+
+static const char *heatName;
+
+void heatOpen(const char *name) {
+    heatName = name;
+    memset(heatMem, 0, sizeof(heatMem));
+    memset(heatIo, 0, sizeof(heatIo));
+    Heating = 1;
+}
+
+// the bytes of an instruction that the fast engine read without memRead()
+void heatInsn(const z80insn *in) {
+    for (int i = 0; i < in->len; i++)
+        heatMem[i < in->refresh ? HEAT_FETCH : HEAT_READ][(uint16_t)(in->pc + i) >> 8]++;
+}
+
+// number of bits of v, a logarithm that does not need libm
+static int heatBits(uint64_t v) {
+    int n = 0;
+    for (; v; v >>= 1)
+        n++;
+    return n;
+}
+
+static uint8_t heatLevel(uint64_t v, int max) {
+    return (uint8_t)(max ? 255 * heatBits(v) / max : 0);
+}
+
+int heatClose(void) {
+    int max = 0;
+
+    if (!Heating)
+        return 1;
+    Heating = 0;
+
+    FILE *fd = fopen(heatName, "w");
+    if (fd == NULL)
+        return 0;
+    fprintf(fd, "type,number,fetch,read,write\n");
+    for (int r = 0; r < 256; r++)
+        fprintf(fd, "mem,0x%04X,%llu,%llu,%llu\n", r << 8, (unsigned long long)heatMem[HEAT_FETCH][r],
+                (unsigned long long)heatMem[HEAT_READ][r], (unsigned long long)heatMem[HEAT_WRITE][r]);
+    for (int p = 0; p < 256; p++)
+        fprintf(fd, "io,0x%02X,0,%llu,%llu\n", p, (unsigned long long)heatIo[HEAT_READ][p],
+                (unsigned long long)heatIo[HEAT_WRITE][p]);
+    int ok = fclose(fd) == 0;
+
+    // one scale for all colors, so the colors can be compared
+    for (int k = 0; k < HEAT_KINDS; k++)
+        for (int i = 0; i < 256; i++) {
+            if (heatBits(heatMem[k][i]) > max)
+                max = heatBits(heatMem[k][i]);
+            if (heatBits(heatIo[k][i]) > max)
+                max = heatBits(heatIo[k][i]);
+        }
+
+    size_t n = strlen(heatName);
+    char *ppmName = malloc(n + 5);
+    if (ppmName == NULL)
+        return 0;
+    memcpy(ppmName, heatName, n);
+    memcpy(ppmName + n, ".ppm", 5);
+    fd = fopen(ppmName, "wb");
+    free(ppmName);
+    if (fd == NULL)
+        return 0;
+    fprintf(fd, "P6\n%d %d\n255\n", 32 * HEAT_CELL, 16 * HEAT_CELL);
+    for (int y = 0; y < 16 * HEAT_CELL; y++)
+        for (int x = 0; x < 32 * HEAT_CELL; x++) {
+            uint64_t (*heat)[256] = x < 16 * HEAT_CELL ? heatMem : heatIo;
+            int i = (y / HEAT_CELL) * 16 + (x / HEAT_CELL) % 16;
+            uint8_t rgb[3] = {
+                heatLevel(heat[HEAT_WRITE][i], max),
+                heatLevel(heat[HEAT_READ][i], max),
+                heatLevel(heat[HEAT_FETCH][i], max)
+            };
+            // a dark line between the cells
+            if (x % HEAT_CELL == 0 || y % HEAT_CELL == 0)
+                for (int c = 0; c < 3; c++)
+                    rgb[c] /= 2;
+            fwrite(rgb, 1, 3, fd);
+        }
+    return fclose(fd) == 0 && ok;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "z80.h"
+
+/*
+    Interrupts
+
+    The CPU takes an interrupt at the end of an instruction:
+
+        NMI     falling edge of _nmi, IFF1 is cleared, IFF2 keeps it for
+                RETN, RST 66h in 11 T states
+        IM 0    _int low and IFF1 set, the opcode on the data bus is executed,
+                RST p (0xFF is RST 38h when nothing drives the bus), 13 T states
+        IM 1    RST 38h, 13 T states
+        IM 2    the routine at the address read from I << 8 | data bus, 19 T states
+
+    The acknowledge cycle of _int is an M1 cycle of 7 T states (2 wait
+    states) that reads the data bus instead of the memory, it is counted in
+    z80.count.intAck. An interrupt is not taken after EI, only after the
+    instruction that follows it.
+
+    The instructions do not look at the pins. intPending is the one word
+    that says that something has to happen between two instructions:
+    INT_NMI is latched by the edge of _nmi, INT_IRQ is set while _int is
+    low and IFF1 is set, INT_HALT while HALT waits for an interrupt.
+    intCheck() computes it after everything that can make an interrupt
+    pending: EI, RETI, RETN and a pin moved by eventPin(). It also sets
+    runStop to 0, so the run loops of z80fast.c and z80block.c return at
+    their test of runStop and the interrupt costs them no test of their
+    own; runSlices(), the loop of stepZ80() and the loop of emuZ80() test
+    intPending and call intService(). A block of the block cache runs to
+    its end, like for the events.
+
+    With HALT the CPU executes NOP M1 cycles until an interrupt comes.
+    runSlices() counts all of them up to the next event or the end of the
+    slice at once, the other loops one at a time.
+
+    The emulation ends when no interrupt can come any more: no posted
+    event moves _nmi, or _int while interrupts are enabled.
+
+    -q T[/byte] pulls _int low every T states, the acknowledge cycle
+    releases it and reads byte (default 0xFF) from the data bus. IM 0 only
+    executes RST p, so byte has to be an RST opcode (0xC7, 0xCF ... 0xFF),
+    it is also the low byte of the vector for IM 2. -n T gives a pulse on
+    _nmi every T states.
+*/
+
+uint8_t intPending;                     // INT_... between two instructions
+
+static uint8_t nmiLevel = 1;            // _nmi at the last intCheck(), for the edge
+static uint64_t eiInstruction = UINT64_MAX;  // MaxInstrictions of the last EI
+
+static uint32_t intPeriod;              // -q, T states between two INT requests
+static uint32_t nmiPeriod;              // -n, T states between two NMI pulses
+static uint8_t intData = 0xFF;          // data bus in the acknowledge cycle
+static uint8_t intRequest;              // the timer holds _int low
+static uint64_t intNext, nmiNext;       // T state of the next tick
+
+// after a change of the pins or of IFF1
+void intCheck(void) {
+    if (_nmi == 0 && nmiLevel == 1)
+        intPending |= INT_NMI;
+    nmiLevel = _nmi;
+    if (_int == 0 && z80.iff1)
+        intPending |= INT_IRQ;
+    else
+        intPending &= ~INT_IRQ;
+    if (intPending)
+        runStop = 0;
+}
+
+// EI, no interrupt until the next instruction is done
+void intEnable(void) {
+    z80.iff1 = 1;
+    z80.iff2 = 1;
+    eiInstruction = MaxInstrictions;
+    intCheck();
+}
+
+// HALT, the run loops return and intService() executes the NOPs
+void intHalt(void) {
+    _halt = 0;
+    intPending |= INT_HALT;
+    runStop = 0;
+}
+
+// the CPU is halted and no interrupt can end the HALT
+int intStopped(void) {
+    return intPending == INT_HALT && !eventMoves(&_nmi) && !(z80.iff1 && eventMoves(&_int));
+}
+
+static void intPush(uint16_t value) {
+    memWrite(--SP, value >> 8);
+    memWrite(--SP, value & 0xFF);
+}
+
+// PC after the HALT is pushed, the CPU runs again
+static void intWake(void) {
+    _halt = 1;
+    intPending &= ~INT_HALT;
+}
+
+// the pending interrupt, 0 when it is not taken
+static int intAccept(void) {
+    uint16_t pc = intPending & INT_HALT ? (uint16_t)(PC - 1) : PC;    // for the profile
+    uint16_t vector;
+
+    if (intPending & INT_NMI) {
+        intPending &= ~INT_NMI;
+        intWake();
+        // M1 cycle of 5 T states, the opcode is not used
+        R = (R & 0x80) | ((R + 1) & 0x7F);
+        MaxCycles += 3;
+        MaxClocks += 11;
+        z80.count.fetch++;
+        z80.count.refresh++;
+        z80.iff1 = 0;
+        intPush(PC);
+        PC = 0x0066;
+        if (DEBUG(1))
+            printf("\n\nNMI -> 0x0066");
+        if (Profiling)
+            profileInterrupt(pc, PC);
+        return 1;
+    }
+
+    if (_int != 0 || !z80.iff1) {
+        intPending &= ~INT_IRQ;
+        return 0;
+    }
+    // the instruction after EI runs first, the run loop returns after it
+    if (MaxInstrictions == eiInstruction) {
+        runStop = MaxClocks + 1;
+        return 0;
+    }
+
+    intPending &= ~INT_IRQ;
+    intWake();
+    R = (R & 0x80) | ((R + 1) & 0x7F);
+    z80.count.intAck++;
+    z80.count.refresh++;
+    z80.iff1 = 0;
+    z80.iff2 = 0;
+    if (intRequest) {
+        intRequest = 0;
+        _int = 1;
+    }
+    intPush(PC);
+    switch (z80.im) {
+        case 2:
+            vector = (uint16_t)(I << 8 | intData);
+            PC = (uint16_t)(memRead(vector) | memRead(vector + 1) << 8);
+            MaxCycles += 5;
+            MaxClocks += 19;
+            break;
+        case 1:
+            PC = 0x0038;
+            MaxCycles += 3;
+            MaxClocks += 13;
+            break;
+        default:
+            // RST p, intTimer() accepts no other opcode
+            PC = intData & 0x38;
+            MaxCycles += 3;
+            MaxClocks += 13;
+            break;
+    }
+    if (DEBUG(1))
+        printf("\n\nINT IM %d -> 0x%04X", z80.im, PC);
+    if (Profiling)
+        profileInterrupt(pc, PC);
+    return 1;
+}
+
+// what intPending asks for: the interrupt, or the NOPs of HALT up to stop,
+// 0 when nothing was done and the next instruction runs
+int intService(uint64_t stop) {
+    if ((intPending & (INT_NMI | INT_IRQ)) && intAccept())
+        return 1;
+    if (!(intPending & INT_HALT))
+        return 0;
+    // the NOPs of 4 T states up to stop are counted at once, at least one
+    uint64_t nops = stop > MaxClocks ? (stop - MaxClocks + 3) / 4 : 1;
+    R = (R & 0x80) | ((R + nops) & 0x7F);
+    MaxCycles += nops;
+    MaxClocks += 4 * nops;
+    z80.count.fetch += nops;
+    z80.count.refresh += nops;
+    z80.count.halt += nops;
+    if (Profiling)
+        profileSample((uint16_t)(PC - 1));
+    return 1;
+}
+
+static void intTick(void *arg, uint32_t value) {
+    (void)arg;
+    (void)value;
+    _int = 0;
+    intRequest = 1;
+    intCheck();
+    intNext += intPeriod;
+    eventPost(intNext, intTick, &_int, 0);
+}
+
+static void nmiTick(void *arg, uint32_t value) {
+    (void)arg;
+    (void)value;
+    _nmi = 0;
+    intCheck();
+    _nmi = 1;
+    intCheck();
+    nmiNext += nmiPeriod;
+    eventPost(nmiNext, nmiTick, &_nmi, 0);
+}
+
+// -q T[/byte], byte is an RST opcode
+int intTimer(const char *spec) {
+    unsigned long data = intData;
+    char *end;
+
+    intPeriod = (uint32_t)strtoul(spec, &end, 0);
+    if (*end == '/')
+        data = strtoul(end + 1, &end, 0);
+    if (*end != 0 || intPeriod == 0 || data > 0xFF || (data & 0xC7) != 0xC7)
+        return 0;
+    intData = (uint8_t)data;
+    return 1;
+}
+
+// -n T
+int nmiTimer(const char *spec) {
+    char *end;
+
+    nmiPeriod = (uint32_t)strtoul(spec, &end, 0);
+    return *end == 0 && nmiPeriod > 0;
+}
+
+// posts the first ticks of the timers, after the counters were cleared
+void intStart(void) {
+    intNext = MaxClocks + intPeriod;
+    nmiNext = MaxClocks + nmiPeriod;
+    if (intPeriod)
+        eventPost(intNext, intTick, &_int, 0);
+    if (nmiPeriod)
+        eventPost(nmiNext, nmiTick, &_nmi, 0);
+}
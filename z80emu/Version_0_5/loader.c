@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "z80.h"
+
+/*
+    Loading of the program
+
+    The file is given on the command line (default ROM.bin), -l addr sets
+    the address it is loaded at. The format comes from the name:
+
+        .hex .ihx   Intel HEX, the addresses of the records plus -l
+        .com        CP/M program, loaded at 0100h, PC starts there
+        other       raw binary, loaded at 0000h
+
+    The file is mapped read-only with mmap(), so many emulators that load
+    the same image share it in the page cache. The bytes of all formats go
+    through loadStore(): a whole page of the memory map that is read from
+    other memory than it is written to (ROM) gets a read pointer into the
+    mapped file and nothing is copied, every other byte is copied into
+    the memory the page is read from. A ROM with banks (mmu.c) is mapped
+    as a whole, a mapping of zeros after the file fills up the last bank.
+*/
+
+static const char *loadName;
+
+// the bytes of the image at addr, mapped when they are in the same file for the run
+static void loadStore(uint32_t addr, const uint8_t *data, uint32_t len, int mapped) {
+    while (len > 0) {
+        z80page *p = &memMap[(addr / MEM_PAGE) % MEM_PAGES];
+        uint32_t offset = addr % MEM_PAGE;
+        uint32_t n = MEM_PAGE - offset < len ? MEM_PAGE - offset : len;
+
+        if (mapped && offset == 0 && p->read && !p->code)
+            // the mapping ends on a host page, the rest of the last page is 0
+            memSwitch((uint16_t)addr, MEM_PAGE, (uint8_t *)data);
+        else if (p->read)
+            memcpy(p->read + offset, data, n);
+        addr += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// size bytes of the file, and zeros up to mapSize
+static uint8_t *loadMap(int fd, size_t size, size_t mapSize) {
+    uint8_t *map = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (map == MAP_FAILED)
+        return NULL;
+    if (size > 0 && mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(map, mapSize);
+        return NULL;
+    }
+    return map;
+}
+
+static int hexByte(const char *s) {
+    int v = 0;
+
+    for (int i = 0; i < 2; i++) {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9')
+            v |= c - '0';
+        else if (c >= 'A' && c <= 'F')
+            v |= c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f')
+            v |= c - 'a' + 10;
+        else
+            return -1;
+    }
+    return v;
+}
+
+// Intel HEX records, returns the end of the highest record or -1
+static long loadHex(const char *text, size_t size, uint32_t base) {
+    const char *p = text, *end = text + size;
+    uint8_t bytes[256 + 5];
+    long top = 0;
+    int line = 0;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+        line++;
+        if (*p == ':') {
+            // the count is read only when the line has it
+            int count = eol - p < 3 ? -1 : hexByte(p + 1), sum = 0;
+            if (count < 0 || eol - p < 11 + 2 * count) {
+                printf("%s: wrong record in line %d\n", loadName, line);
+                return -1;
+            }
+            for (int i = 0; i < count + 5; i++) {
+                int b = hexByte(p + 1 + 2 * i);
+                if (b < 0) {
+                    printf("%s: wrong record in line %d\n", loadName, line);
+                    return -1;
+                }
+                bytes[i] = (uint8_t)b;
+                sum += b;
+            }
+            if (sum & 0xFF) {
+                printf("%s: wrong checksum in line %d\n", loadName, line);
+                return -1;
+            }
+            uint32_t addr = base + (bytes[1] << 8 | bytes[2]);
+            if (bytes[3] == 0x01)
+                break;
+            if (bytes[3] == 0x00) {
+                loadStore(addr, bytes + 4, count, 0);
+                if ((long)(addr + count) > top)
+                    top = addr + count;
+            }
+            // 02 and 04 move the records above 64 KB, 03 and 05 are start addresses
+            else if ((bytes[3] == 0x02 || bytes[3] == 0x04) && (bytes[4] | bytes[5])) {
+                printf("%s: records above 64 KB in line %d\n", loadName, line);
+                return -1;
+            }
+        }
+        p = eol + 1;
+    }
+    return top;
+}
+
+static int hasExtension(const char *name, const char *ext) {
+    size_t n = strlen(name), e = strlen(ext);
+    return n >= e && strcasecmp(name + n - e, ext) == 0;
+}
+
+// loads the program, addr -1 is the address of the format, returns the end of the image or -1
+long loadImage(const char *name, long addr, uint16_t *start) {
+    struct stat st;
+    int hex = hasExtension(name, ".hex") || hasExtension(name, ".ihx");
+    int com = hasExtension(name, ".com");
+    long top;
+
+    loadName = name;
+    int fd = open(name, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("File %s not found! \n", name);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if (addr < 0)
+        addr = com ? 0x0100 : 0;
+    *start = com ? (uint16_t)addr : 0;
+
+    size_t size = (size_t)st.st_size;
+    size_t mapSize = (size + MEM_PAGE - 1) / MEM_PAGE * MEM_PAGE;
+    if (Banking) {
+        if (hex || com || addr != 0 || (mapSize = mmuImageSize(size)) == 0) {
+            printf("File %s is not a raw image at 0 of up to %d Bytes for the banks! \n", name, MMU_ROM_MAX);
+            close(fd);
+            return -1;
+        }
+    }
+    else if (!hex && addr + size > 65536) {
+        printf("File %s does not fit at 0x%lX! \n", name, addr);
+        close(fd);
+        return -1;
+    }
+
+    uint8_t *map = loadMap(fd, size, mapSize ? mapSize : MEM_PAGE);
+    close(fd);
+    if (map == NULL) {
+        printf("Cannot map %s\n", name);
+        return -1;
+    }
+
+    if (hex) {
+        top = loadHex((const char *)map, size, (uint32_t)addr);
+        munmap(map, mapSize ? mapSize : MEM_PAGE);
+    }
+    else if (Banking) {
+        mmuInit(map, (uint32_t)mapSize);
+        top = (long)size;
+    }
+    else {
+        loadStore((uint32_t)addr, map, (uint32_t)size, 1);
+        top = addr + (long)size;
+    }
+    return top;
+}
@@ -0,0 +1,1960 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "z80.h"
+
+/*
+    This is a Hardware Level Emulator for the Zilog Z80 Processor.
+
+    This emulator is created with the purpose of testing the functioning of the code
+    to create a Z80 emulator that will run on a Raspberry Pi PICO.
+
+    Copyright (c) 2024 Linca Marius Gheorghe
+
+    Version 0.3 - immediate value loading into register implemented
+                - immediate value loading into register pair implemented
+    Version 0.4 - Copy data between registers instructions implemented
+    Version 0.5 - Instruction level execution engine (z80fast.c)
+*/
+
+int Debug = 15;
+int Wait = 1;
+long Limit = 190;  // nr of tick to run
+int Engine = 0;    // 0 = half clock engine emuZ80(), 1 = instruction level engine stepZ80(), 2 = block cache
+int Jit = 1;       // translate hot blocks of the block cache to host code
+
+z80status z80;
+
+uint16_t address;       // Address Bus
+uint8_t data;           // Data Bus
+
+// control signals
+uint8_t _m1; 	        // out
+uint8_t _mreq;          // out
+uint8_t _ireq;          // out
+uint8_t _rd;            // out
+uint8_t _wr;            // out
+uint8_t _rfsh;          // out
+uint8_t _halt;          // out
+uint8_t _wait;          // in
+uint8_t _int;           // in
+uint8_t _nmi;           // in
+uint8_t _reset;         // in
+uint8_t _busrq;         // in
+uint8_t _busack;        // out
+uint8_t _clk;           // in
+//TO DO: make them boolean
+
+void resetZ80(void) {
+    if (DEBUG(1))
+        printf("\nReset Z80 Emulator ");
+    PC = 0;
+    if (DEBUG(2))
+        printf("-> PC = 0, ");
+	SP = 0;
+    if (DEBUG(2))
+        printf(" SP = 0, ");
+	Cycles = 0;
+    if (DEBUG(2))
+        printf(" Cycles = 0, ");
+	Step = 0;
+    if (DEBUG(2))
+        printf(" Step = 0");
+    if (DEBUG(1))
+        printf("\nDebug Level = %d\n\n", Debug);
+    ZOpcode = 0;
+    _m1 = 1;
+    _mreq = 1;
+    _ireq = 1;
+    _rd = 1;
+    _wr = 1;
+    _rfsh = 1;
+    _halt = 1;
+    _busack = 1;
+    z80.iff1 = 0;
+    z80.iff2 = 0;
+    z80.im = 0;
+    intPending = 0;
+}
+
+// flags of LD A,I and LD A,R, P/V is a copy of IFF2
+void setFlags(void){
+    F = (F & FLAG_C) | flagTableSZ53[A] | (z80.iff2 ? FLAG_PV : 0);
+}
+
+/*
+    The half clock engine is built twice from emuHalf(): emuZ80() without
+    any trace output and emuZ80Trace() with the levels up to Z80_TRACE and
+    the binary trace. trace is a constant in both, the compiler removes the
+    checks above it.
+*/
+
+#define TRACE(n) ((n) <= trace && Debug >= (n))
+
+#if defined(__GNUC__)
+__attribute__((always_inline))
+#endif
+static inline void emuHalf(const int trace) {
+    if (trace && Tracing)
+        traceClock();
+    if (TRACE(4))
+        printf("\n  Opcode = 0x%04X, ",ZOpcode);
+    if (TRACE(5))
+        printf("Step = %d, ",Step);
+    if (TRACE(6))
+        printf("Clk = %d, ", _clk);
+    if (TRACE(7))
+        printf("PC = 0x%X -- ", PC);
+
+    //Machine Cycle M1 - Step T1 - Opcode Fetch
+    if (Step == 0) {
+    	if (_clk == 1) {
+    		address = PC;
+		    _m1 = 0;
+            if (TRACE(8))
+                printf("M1 - T1 - P_Clk");
+	    }
+        else { // (_clk == 0)
+            _mreq = 0;
+            _rd = 0;
+            Step++;
+            MaxClocks++;
+            if (TRACE(8))
+                printf(" - N_Clk, ");
+        }
+        return;
+	}
+
+    //Machine Cycle M1 - Step T2 - Opcode Fetch
+    if (Step == 1) {
+    	if (_clk == 1) {
+            if (TRACE(8))
+                printf("M1 - T2 - P_Clk ");
+        }
+        else if (_clk == 0 && _wait == 0){
+            if (TRACE(8))
+                printf("- TW ");
+        }
+        else if (_clk == 0 && _wait == 1) {
+            ZOpcodeL = data;
+            Step++;
+            MaxClocks++;
+            if (TRACE(8))
+                printf("- N_Clk, ");
+        }
+        return;
+	}
+
+    //Machine Cycle M1 - Step T3 - Opcode Fetch - Refresh + Instruction decoding
+    if (Step == 2) {
+    	if (_clk == 1) {
+    		address = (PC | R);
+            _mreq = 1;
+            _rd = 1;
+            _m1 = 1;
+            _rfsh = 0;
+            if (TRACE(8))
+                printf("M1 - T3 - P_Clk ");
+        }
+        else { // (_clk == 0)
+            // Decode instruction T4
+            switch(ZOpcode) {
+                case 0x00: // NOP - no operation
+                    if (TRACE(1))
+                        printf("\n\nNOP");
+                    break;
+                case 0x01: // LD BC, nn - loads nn into BC
+                    if (TRACE(1))
+                        printf("\n\nLD BC, nn");
+                    break;
+                case 0x06: // LD B, n - Loads n into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, n");
+                    break;
+                case 0x0E: // LD C, n - Loads n into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, n");
+                    break;
+                case 0x11: // LD DE, nn - loads nn into DE
+                    if (TRACE(1))
+                        printf("\n\nLD DE, nn");
+                    break;
+                case 0x16: // LD D, n - Loads n into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, n");
+                    break;
+                case 0x1E: // LD E, n - Loads n into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, n");
+                    break;
+                case 0x21: // LD HL, nn - loads nn into HL
+                    if (TRACE(1))
+                        printf("\n\nLD HL, nn");
+                    break;
+                case 0x26: // LD H, n - Loads n into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, n");
+                    break;
+                case 0x2E: // LD L, n - Loads n into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, n");
+                    break;
+                case 0x31: // LD SP, nn - Loads nn into SP
+                    if (TRACE(1))
+                        printf("\n\nLD SP, nn");
+                    break;
+                case 0x3E: // LD A, n - Loads n into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, n");
+                    break;
+                case 0x40: // LD B, B - The contents of B are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, B");
+                    break;
+                case 0x41: // LD B, C - The contents of C are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, C");
+                    break;
+                case 0x42: // LD B, D - The contents of D are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, D");
+                    break;
+                case 0x43: // LD B, E - The contents of E are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, E");
+                    break;
+                case 0x44: // LD B, H - The contents of H are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, H");
+                    break;
+                case 0x45: // LD B, L - The contents of L are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, L");
+                    break;
+                case 0x47: // LD B, A - The contents of A are loaded into B
+                    if (TRACE(1))
+                        printf("\n\nLD B, A");
+                    break;
+                case 0x48: // LD C, B - The contents of B are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, B");
+                    break;
+                case 0x49: // LD C, C - The contents of C are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, C");
+                    break;
+                case 0x4A: // LD C, D - The contents of D are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, D");
+                    break;
+                case 0x4B: // LD C, E - The contents of E are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, E");
+                    break;
+                case 0x4C: // LD C, H - The contents of H are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, H");
+                    break;
+                case 0x4D: // LD C, L - The contents of L are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, L");
+                    break;
+                case 0x4F: // LD C, A - The contents of A are loaded into C
+                    if (TRACE(1))
+                        printf("\n\nLD C, A");
+                    break;
+                case 0x50: // LD D, B - The contents of B are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, B");
+                    break;
+                case 0x51: // LD D, C - The contents of C are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, C");
+                    break;
+                case 0x52: // LD D, D - The contents of D are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, D");
+                    break;
+                case 0x53: // LD D, E - The contents of E are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, E");
+                    break;
+                case 0x54: // LD D, H - The contents of H are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, H");
+                    break;
+                case 0x55: // LD D, L - The contents of L are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, L");
+                    break;
+                case 0x57: // LD D, A - The contents of A are loaded into D
+                    if (TRACE(1))
+                        printf("\n\nLD D, A");
+                    break;
+                case 0x58: // LD E, B - The contents of B are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, B");
+                    break;
+                case 0x59: // LD E, C - The contents of C are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, C");
+                    break;
+                case 0x5A: // LD E, D - The contents of D are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, D");
+                    break;
+                case 0x5B: // LD E, E - The contents of E are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, E");
+                    break;
+                case 0x5C: // LD E, H - The contents of H are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, H");
+                    break;
+                case 0x5D: // LD E, L - The contents of L are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, L");
+                    break;
+                case 0x5F: // LD E, A - The contents of A are loaded into E
+                    if (TRACE(1))
+                        printf("\n\nLD E, A");
+                    break;
+                case 0x60: // LD H, B - The contents of B are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, B");
+                    break;
+                case 0x61: // LD H, C - The contents of C are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, C");
+                    break;
+                case 0x62: // LD H, D - The contents of D are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, D");
+                    break;
+                case 0x63: // LD H, E - The contents of E are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, E");
+                    break;
+                case 0x64: // LD H, H - The contents of H are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, H");
+                    break;
+                case 0x65: // LD H, L - The contents of L are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, L");
+                    break;
+                case 0x67: // LD H, A - The contents of A are loaded into H
+                    if (TRACE(1))
+                        printf("\n\nLD H, A");
+                    break;
+                case 0x68: // LD L, B - The contents of B are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, B");
+                    break;
+                case 0x69: // LD L, C - The contents of C are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, C");
+                    break;
+                case 0x6A: // LD L, D - The contents of D are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, D");
+                    break;
+                case 0x6B: // LD L, E - The contents of E are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, E");
+                    break;
+                case 0x6C: // LD L, H - The contents of H are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, H");
+                    break;
+                case 0x6D: // LD L, L - The contents of L are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, L");
+                    break;
+                case 0x6F: // LD L, A - The contents of A are loaded into L
+                    if (TRACE(1))
+                        printf("\n\nLD L, A");
+                    break;
+                case 0x76: // HALT - Suspends CPU operation until an interrupt or reset occurs
+                    if (TRACE(1))
+                        printf("\n\nHALT");
+                    break;
+                case 0x78: // LD A, B - The contents of B are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, B");
+                    break;
+                case 0x79: // LD A, C - The contents of C are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, C");
+                    break;
+                case 0x7A: // LD A, D - The contents of D are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, D");
+                    break;
+                case 0x7B: // LD A, E - The contents of E are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, E");
+                    break;
+                case 0x7C: // LD A, H - The contents of H are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, H");
+                    break;
+                case 0x7D: // LD A, L - The contents of L are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, L");
+                    break;
+                case 0x7F: // LD A, A - The contents of A are loaded into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, A");
+                    break;
+                case 0xDD: // DD - set IX instructions prefix
+                    if (TRACE(1))
+                        printf("\n\n(DD) ");
+                    break;
+               case 0xF9: // LD SP, HL - Loads the value of HL into SP
+                    if (TRACE(1))
+                        printf("\n\nLD SP, HL");
+                    break;
+                case 0xFD: // FD - set IY instructions prefix
+                    if (TRACE(1))
+                        printf("\n\n(FD) ");
+                    break;
+                case 0xED: // ED - set Misc. instructions prefix
+                    if (TRACE(1))
+                        printf("\n\n(ED) ");
+                    break;
+                case 0xDD21: // LD IX, nn - loads nn into IX
+                    if (TRACE(1))
+                        printf("\n\nLD IX, nn");
+                    break;
+                case 0xDDF9: // LD SP, IX - Loads the value of IX into SP
+                    if (TRACE(1))
+                        printf("\n\nLD SP, IX");
+                    break;
+                case 0xED47: // LD I, A - Stores the value of A into register I
+                    if (TRACE(1))
+                        printf("\n\nLD I, A");
+                    break;
+                case 0xED4F: // LD R, A - Stores the value of A into register R
+                    if (TRACE(1))
+                        printf("\n\nLD R, A");
+                    break;
+                case 0xED57: // LD A, I - Stores the value of I into register A
+                    if (TRACE(1))
+                        printf("\n\nLD A, I");
+                    break;
+                case 0xED5F: // LD A, R - Stores the value of register R into A
+                    if (TRACE(1))
+                        printf("\n\nLD A, R");
+                    break;
+                case 0xFD21: // LD IY, nn - loads nn into IY
+                    if (TRACE(1))
+                        printf("\n\nLD IY, nn");
+                    break;
+                case 0xFDF9: // LD SP, IY - Loads the value of IY into SP
+                    if (TRACE(1))
+                        printf("\n\nLD SP, IY");
+                    break;
+                default:
+                    break;
+            }
+            _mreq = 0;
+            Step++;
+            MaxClocks++;
+            if (TRACE(8))
+                printf(" - N_Clk, ");
+        }
+        return;
+    }
+
+
+    //Machine Cycle M1 - Step T4 - Opcode Fetch - Refresh + Instruction execution
+    if (Step == 3) {
+    	if (_clk == 1) {
+            PC++;
+            if (TRACE(8))
+                printf("M1 - T4 - P_Clk");
+        }
+        else { // (_clk == 0)
+            _mreq = 1;
+            Step++;
+            //Cycles++;
+            // Decode instruction T4
+            switch(ZOpcode) {
+                case 0x00: // NOP - no operation
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    break;
+                case 0x01: // LD BC, nn - loads nn into BC
+                case 0x06: // LD B, n - Loads n into B
+                case 0x0E: // LD C, n - Loads n into C
+                case 0x11: // LD DE, nn - loads nn into DE
+                case 0x16: // LD D, n - Loads n into D
+                case 0x1E: // LD E, n - Loads n into E
+                case 0x21: // LD HL, nn - loads nn into HL
+                case 0x26: // LD H, n - Loads n into H
+                case 0x2E: // LD L, n - Loads n into L
+                case 0x31: // LD SP, nn - loads nn into SP
+                case 0x3E: // LD A, n - Loads n into A
+                case 0xF9: // LD SP, HL - Loads the value of HL into SP
+                case 0xDD21: // LD IX, nn - loads nn into IX
+                case 0xDDF9: // LD SP, IX - Loads the value of IX into SP
+                case 0xED47: // LD I, A - Stores the value of A into register I
+                case 0xED4F: // LD R, A - Stores the value of A into register R
+                case 0xED57: // LD A, I - Stores the value of I into register A
+                case 0xED5F: // LD A, R - Stores the value of register R into A
+                case 0xFD21: // LD IY, nn - loads nn into IY
+                case 0xFDF9: // LD SP, IY - Loads the value of IY into SP
+                    MaxClocks++;
+                    MaxCycles++;
+                    break;
+                case 0xDD: // DD - set IX instructions prefix
+                case 0xED: // ED - set Misc. instructions prefix
+                case 0xFD: // FD - set IY instructions prefix
+                    ZOpcodeH = ZOpcodeL;
+                    ZOpcodeL = 0;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    break;
+                case 0x40: // LD B, B - The contents of B are loaded into B
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x41: // LD B, C - The contents of C are loaded into B
+                    B = C;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x42: // LD B, D - The contents of D are loaded into B
+                    B = D;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x43: // LD B, E - The contents of E are loaded into B
+                    B = E;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x44: // LD B, H - The contents of H are loaded into B
+                    B = H;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x45: // LD B, L - The contents of L are loaded into B
+                    B = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x47: // LD B, A - The contents of A are loaded into B
+                    B = A;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> B = 0x%02X",B);
+                    break;
+                case 0x48: // LD C, B - The contents of B are loaded into C
+                    C = B;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x49: // LD C, C - The contents of C are loaded into C
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x4A: // LD C, D - The contents of D are loaded into C
+                    C = D;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x4B: // LD C, E - The contents of E are loaded into C
+                    C = E;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x4C: // LD C, H - The contents of H are loaded into C
+                    C = H;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x4D: // LD C, L - The contents of L are loaded into C
+                    C = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x4F: // LD C, A - The contents of A are loaded into C
+                    C = A;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> C = 0x%02X",C);
+                    break;
+                case 0x50: // LD D, B - The contents of B are loaded into D
+                    D = B;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x51: // LD D, C - The contents of C are loaded into D
+                    D = C;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x52: // LD D, D - The contents of D are loaded into D
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x53: // LD D, E - The contents of E are loaded into D
+                    D = E;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x54: // LD D, H - The contents of H are loaded into D
+                    D = H;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x55: // LD D, L - The contents of L are loaded into D
+                    D = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x57: // LD D, A - The contents of A are loaded into D
+                    D = A;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> D = 0x%02X",D);
+                    break;
+                case 0x58: // LD E, B - The contents of B are loaded into E
+                    E = B;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x59: // LD E, C - The contents of C are loaded into E
+                    E = C;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x5A: // LD E, D - The contents of D are loaded into E
+                    E = D;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x5B: // LD E, E - The contents of E are loaded into E
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x5C: // LD E, H - The contents of H are loaded into E
+                    E = H;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x5D: // LD E, L - The contents of L are loaded into E
+                    E = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x5F: // LD E, A - The contents of A are loaded into E
+                    E = A;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> E = 0x%02X",E);
+                    break;
+                case 0x60: // LD H, B - The contents of B are loaded into H
+                    H = B;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x61: // LD H, C - The contents of C are loaded into H
+                    H = C;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x62: // LD H, D - The contents of D are loaded into H
+                    H = D;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x63: // LD H, E - The contents of E are loaded into H
+                    H = E;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x64: // LD H, H - The contents of H are loaded into H
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x65: // LD H, L - The contents of L are loaded into H
+                    H = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x67: // LD H, A - The contents of A are loaded into H
+                    H = A;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> H = 0x%02X",H);
+                    break;
+                case 0x68: // LD L, B - The contents of B are loaded into L
+                    L = B;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x69: // LD L, C - The contents of C are loaded into L
+                    L = C;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x6A: // LD L, D - The contents of D are loaded into L
+                    L = D;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x6B: // LD L, E - The contents of E are loaded into L
+                    L = E;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x6C: // LD L, H - The contents of H are loaded into L
+                    L = H;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x6D: // LD L, L - The contents of L are loaded into L
+                    //L = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x6F: // LD L, A - The contents of A are loaded into L
+                    L = A;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> L = 0x%02X",L);
+                    break;
+                case 0x76: // HALT - Suspends CPU operation until an interrupt or reset occurs
+                    intHalt();
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> HALT");
+                    break;
+                case 0x78: // LD A, B - The contents of B are loaded into A
+                    A = B;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                case 0x79: // LD A, C - The contents of C are loaded into A
+                    A = C;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                case 0x7A: // LD A, D - The contents of D are loaded into A
+                    A = D;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                case 0x7B: // LD A, E - The contents of E are loaded into A
+                    A = E;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                case 0x7C: // LD A, H - The contents of H are loaded into A
+                    A = H;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                case 0x7D: // LD A, L - The contents of L are loaded into A
+                    A = L;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                case 0x7F: // LD A, A - The contents of A are loaded into A
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" ==> A = 0x%02X",A);
+                    break;
+                default:
+                    break;
+            }
+            if (TRACE(8))
+                printf(" - N_Clk, ");
+        }
+        return;
+    }
+
+    //Machine Cycle M2 - Step T1 - Memory Read/Write Cycle
+    if (Step == 4) {
+        // Decode instruction T5
+        switch(ZOpcode) {
+            case 0x01: // LD BC, nn - loads nn into BC
+            case 0x06: // LD B, n - Loads n into B
+            case 0x0E: // LD C, n - Loads n into C
+            case 0x11: // LD DE, nn - loads nn into DE
+            case 0x16: // LD D, n - Loads n into D
+            case 0x1E: // LD E, n - Loads n into E
+            case 0x21: // LD HL, nn - loads nn into HL
+            case 0x26: // LD H, n - Loads n into H
+            case 0x2E: // LD L, n - Loads n into L
+            case 0x31: // LD SP, nn - loads nn into SP
+            case 0x3E: // LD A, n - Loads n into A
+            case 0xDD21: // LD IX, nn - loads nn into IX
+            case 0xFD21: // LD IY, nn - loads nn into IY
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    _mreq = 0;
+                    _rd = 0;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk, ");
+                }
+                break;
+            case 0xED47: // LD I, A - Stores the value of A into register I
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    I = A;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    ZOpcode = 0;
+                    if (TRACE(8))
+                        printf(" - N_Clk, ==> I = 0x%02X",I);
+                }
+                break;
+            case 0xED4F: // LD R, A - Stores the value of A into register R
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    R = A;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    ZOpcode = 0;
+                    if (TRACE(8))
+                        printf(" - N_Clk, ==> R = 0x%02X",R);
+                }
+                break;
+            case 0xED57: // LD A, I - Stores the value of I into register A
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    A = I;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    ZOpcode = 0;
+                    setFlags();
+                    if (TRACE(8))
+                        printf(" - N_Clk, ==> A = 0x%02X",A);
+                }
+                break;
+            case 0xED5F: // LD A, R - Stores the value of register R into A
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    A = R;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    ZOpcode = 0;
+                    setFlags();
+                    if (TRACE(8))
+                        printf(" - N_Clk, ==> A = 0x%02X",A);
+                }
+                break;
+            case 0xF9: // LD SP, HL - Loads the value of HL into SP
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    SPL = L;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> SPL = 0x%02X",SPL);
+                }
+                break;
+            case 0xDDF9: // LD SP, IX - Loads the value of IX into SP
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    SPL = IXL;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> SPL = 0x%02X",SPL);
+                }
+                break;
+            case 0xFDF9: // LD SP, IY - Loads the value of IY into SP
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M2 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    SPL = IYL;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> SPL = 0x%02X",SPL);
+                }
+                break;
+            default:
+                break;
+            }
+        return;
+        }
+
+    //Machine Cycle M2 - Step T2 - Memory Read Cycle
+    if (Step == 5) {
+        // Decode instruction T5
+        switch(ZOpcode) {
+            case 0x01: // LD BC, nn - loads nn into BC
+            case 0x06: // LD B, n - Loads n into B
+            case 0x0E: // LD C, n - Loads n into C
+            case 0x11: // LD DE, nn - loads nn into DE
+            case 0x16: // LD D, n - Loads n into D
+            case 0x1E: // LD E, n - Loads n into E
+            case 0x21: // LD HL, nn - loads nn into HL
+            case 0x26: // LD H, n - Loads n into H
+            case 0x2E: // LD L, n - Loads n into L
+            case 0x31: // LD SP, nn - loads nn into SP
+            case 0x3E: // LD A, n - Loads n into A
+            case 0xDD21: // LD IX, nn - loads nn into IX
+            case 0xFD21: // LD IY, nn - loads nn into IY
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T2 - P_Clk");
+                }
+                else if (_clk == 0 && _wait == 0){
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf("- TW ");
+                }
+                else if (_clk == 0 && _wait == 1) {
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf("- N_Clk, ");
+                }
+                break;
+            case 0xF9: // LD SP, HL - Loads the value of HL into SP
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T2 - P_Clk");
+                }
+                else { // _clk == 1
+                    SPH = H;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf("- N_Clk ==> SPH = 0x%02X, ===> SP = 0x%04X",SPH,SP);
+                }
+                break;
+            case 0xDDF9: // LD SP, IX - Loads the value of IX into SP
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T2 - P_Clk");
+                }
+                else { // _clk == 1
+                    SPH = IXH;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    ZOpcode = 0;
+                    if (TRACE(8))
+                        printf("- N_Clk ==> SPH = 0x%02X, ===> SP = 0x%04X",SPH,SP);
+                }
+                break;
+            case 0xFDF9: // LD SP, IY - Loads the value of IY into SP
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T2 - P_Clk");
+                }
+                else { // _clk == 1
+                    SPH = IYH;
+                    Step = 0;
+                    MaxClocks++;
+                    //MaxCycles++;
+                    MaxInstrictions++;
+                    ZOpcode = 0;
+                    if (TRACE(8))
+                        printf("- N_Clk ==> SPH = 0x%02X, ===> SP = 0x%04X",SPH,SP);
+                }
+                break;
+            default:
+                break;
+        }
+        return;
+	}
+
+    //Machine Cycle M2 - Step T3 - Memory Read Cycle
+    if (Step == 6) {
+        // Decode instruction T7
+        switch(ZOpcode) {
+            case 0x01: // LD BC, nn - loads nn into BC
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    C = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step++;
+                    //Cycles++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> C = 0x%02X",C);
+                }
+                break;
+            case 0x06: // LD B, n - Loads n into B
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    B = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> B = 0x%02X",B);
+                }
+                break;
+            case 0x0E: // LD C, n - Loads n into C
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    C = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    Cycles++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> C = 0x%02X",C);
+                }
+                break;
+            case 0x11: // LD DE, nn - loads nn into DE
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    E = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> E = 0x%02X",E);
+                }
+                break;
+            case 0x16: // LD D, n - Loads n into D
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    D = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    //Cycles++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> D = 0x%02X",D);
+                }
+                break;
+            case 0x1E: // LD E, n - Loads n into E
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    E = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    //Cycles++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> E = 0x%02X",E);
+                }
+                break;
+            case 0x21: // LD HL, nn - loads nn into HL
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    L = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> L = 0x%02X",L);
+                }
+                break;
+            case 0x26: // LD H, n - Loads n into H
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    H = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    Cycles++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> H = 0x%02X",H);
+                }
+                break;
+            case 0x2E: // LD L, n - Loads n into L
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    L = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    Cycles++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> L = 0x%02X",L);
+                }
+                break;
+            case 0x31: // LD SP, nn - loads nn into SP
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    SPL = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> SPL = 0x%02X",SPL);
+                }
+                break;
+            case 0x3E: // LD A, n - Loads n into A
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    A = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> A = 0x%02X",A);
+                }
+                break;
+            case 0xDD21: // LD IX, nn - loads nn into IX
+            case 0xFD21: // LD IY, nn - loads nn into IY
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M2 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    ZTemp8 = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> temp = 0x%02X",ZTemp8);
+                }
+                break;
+            default:
+                break;
+        }
+        return;
+	}
+
+    //Machine Cycle M3 - Step T1 - Memory Read/Write Cycle
+    if (Step == 7) {
+        // Decode instruction T8
+        switch(ZOpcode) {
+            case 0x01: // LD BC, nn - loads nn into BC
+            case 0x11: // LD DE, nn - loads nn into DE
+            case 0x21: // LD HL, nn - loads nn into HL
+            case 0x31: // LD SP, nn - loads nn into SP
+            case 0xDD21: // LD IX, nn - loads nn into IX
+            case 0xFD21: // LD IY, nn - loads nn into IY
+                if (_clk == 1) {
+                    address = PC;
+                    if (TRACE(8))
+                        printf("M3 - T1 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    _mreq = 0;
+                    _rd = 0;
+                    Step++;
+                    MaxClocks++;
+                    if (TRACE(8))
+                        printf(" - N_Clk, ");
+                }
+                break;
+            default:
+                break;
+            }
+        return;
+    }
+
+    //Machine Cycle M3 - Step T2 - Memory Read Cycle
+    if (Step == 8) {
+    	if (_clk == 1) {
+            if (TRACE(8))
+                printf("M3 - T2 - P_Clk ");
+        }
+        else if (_clk == 0 && _wait == 0){
+            MaxClocks++;
+            if (TRACE(3))
+                printf("- TW ");
+        }
+        else if (_clk == 0 && _wait == 1) {
+            Step++;
+            MaxClocks++;
+            if (TRACE(8))
+                printf("- N_Clk, ");
+        }
+        return;
+    }
+
+    //Machine Cycle M3 - Step T3 - Memory Read Cycle
+    if (Step == 9) {
+        // Decode instruction T10
+        switch(ZOpcode) {
+            case 0x01: // LD BC, nn - loads nn into BC
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M3 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    B = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    //Cycles++;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> B = 0x%02X, C = 0x%02X ===> BC = 0x%04X",B,C,BC);
+                }
+                break;
+            case 0x11: // LD DE, nn - loads nn into DE
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M3 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    D = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> D = 0x%02X, E = 0x%02X ===> DE = 0x%04X",D,E,DE);
+                }
+                break;
+            case 0x21: // LD HL, nn - loads nn into HL
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M3 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    H = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> H = 0x%02X, L = 0x%02X ===> HL = 0x%04X",H,L,HL);
+                }
+                break;
+            case 0x31: // LD SP, nn - loads nn into SP
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M3 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    SPH = data;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ==> SPL = 0x%02X, SPH = 0x%02X ===> SP = 0x%04X",SPL,SPH,SP);
+                }
+                break;
+            case 0xDD21: // LD IX, nn - loads nn into IX
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M3 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    IX = (data << 8) + ZTemp8;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    ZOpcode = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ===> IX = 0x%04X",IX);
+                }
+                break;
+            case 0xFD21: // LD IY, nn - loads nn into IY
+                if (_clk == 1) {
+                    if (TRACE(8))
+                        printf("M3 - T3 - P_Clk");
+                }
+                else { // (_clk == 0)
+                    IY = (data << 8) + ZTemp8;
+                    _mreq = 1;
+                    _rd = 1;
+                    PC++;
+                    Step = 0;
+                    ZOpcode = 0;
+                    MaxClocks++;
+                    MaxCycles++;
+                    MaxInstrictions++;
+                    if (TRACE(8))
+                        printf(" - N_Clk ===> IY = 0x%04X",IY);
+                }
+                break;
+            default:
+                break;
+        }
+        return;
+	}
+
+}
+
+void emuZ80(void) {
+    emuHalf(0);
+}
+
+void emuZ80Trace(void) {
+    emuHalf(Z80_TRACE);
+}
+
+// counts the M cycle that starts when _mreq goes low, after every half clock,
+// and adds it to the heat map of its region
+static void countBus(void) {
+    static uint8_t mreq = 1;
+
+    if (_mreq == 0 && mreq == 1) {
+        int kind = -1;
+        if (_m1 == 0) {
+            z80.count.fetch++;
+            kind = HEAT_FETCH;
+        }
+        else if (_rd == 0) {
+            z80.count.memRead++;
+            kind = HEAT_READ;
+        }
+        else if (_wr == 0) {
+            z80.count.memWrite++;
+            kind = HEAT_WRITE;
+        }
+        else if (_rfsh == 0)
+            z80.count.refresh++;
+        if (Heating && kind >= 0)
+            heatMem[kind][address >> 8]++;
+    }
+    mreq = _mreq;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// main console program
+int main(int argc, char *argv[]) {
+
+    printf("\nZ80 Emulator\n");
+
+    char *codeFile = "ROM.bin";
+    long loadAddr = -1;
+    uint16_t startPc = 0;
+    char *traceName = NULL;
+    char *stateName = NULL;
+    char *profileName = NULL;
+    uint32_t interval = 1000;
+    long filelen;
+    long counter = 0;
+    clock_t start;
+    double seconds;
+
+    memInit();
+
+    // command line options
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "half") == 0)
+                Engine = 0;
+            else if (strcmp(argv[i], "fast") == 0)
+                Engine = 1;
+            else if (strcmp(argv[i], "block") == 0)
+                Engine = 2;
+            else {
+                printf("Unknown engine %s, use half, fast or block\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            Debug = atoi(argv[++i]);
+            if (Debug > Z80_TRACE && Z80_TRACE < 9)
+                printf("Debug levels above %d are not built, see Z80_TRACE\n", Z80_TRACE);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            traceName = argv[++i];
+            if (Z80_TRACE == 0)
+                printf("The binary trace is not built, see Z80_TRACE\n");
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            stateName = argv[++i];
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            statsOpen(argv[++i], STATS_COUNT);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            statsOpen(argv[++i], STATS_HOST);
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            profileName = argv[++i];
+        else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+            coverOpen(argv[++i]);
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            heatOpen(argv[++i]);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            if (!mmuWindow(argv[++i])) {
+                printf("Wrong bank window %s, it is addr/size_kb/port or addr/size_kb/maddress\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            if (!intTimer(argv[++i])) {
+                printf("Wrong interrupt timer %s, it is T_states or T_states/data with data an RST opcode (0xC7, 0xCF ... 0xFF)\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            if (!nmiTimer(argv[++i])) {
+                printf("Wrong NMI timer %s, it is T_states\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            if (!paceClock(argv[++i])) {
+                printf("Wrong clock %s, it is the clock in MHz\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            loadAddr = strtol(argv[++i], NULL, 0) & 0xFFFF;
+        else if (argv[i][0] != '-')
+            codeFile = argv[i];
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            interval = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            Jit = strcmp(argv[++i], "off") != 0;
+        else if (strcmp(argv[i], "-b") == 0) {
+            benchZ80();
+            return 0;
+        }
+        else {
+            printf("Usage: %s [-e half|fast|block] [-j on|off] [-d debug_level] [-t trace_file] [-s state_file] [-c|-p stats_file] [-g profile_file] [-i interval] [-v coverage_file] [-a heat_file] [-k addr/size/latch] [-q T[/data]] [-n T] [-m MHz] [-l addr] [-b] [rom_file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Load the ROM file
+    filelen = loadImage(codeFile, loadAddr, &startPc);
+    if (filelen < 0) {
+        printf("Press Any Key to Exit\n");
+        return 1;
+    }
+
+    // set input control signals
+	_wait = 1;	// in
+	_int = 1;	// in
+	_nmi = 1;	// in
+ 	_reset = 1;	// in
+ 	_busrq = 1;	// in
+ 	_clk = 0;	// in
+
+    resetZ80();
+    PC = startPc;
+
+    if (traceName != NULL && Z80_TRACE > 0 && !traceOpen(traceName)) {
+        printf("Cannot write the trace file %s\n", traceName);
+        return 1;
+    }
+    if (stateName != NULL && !stateOpen(stateName)) {
+        printf("Cannot write the state file %s\n", stateName);
+        return 1;
+    }
+    if (profileName != NULL && !profileOpen(profileName, interval)) {
+        printf("No memory for the profile\n");
+        return 1;
+    }
+
+    memset(&z80.count, 0, sizeof(z80.count));
+    intStart();
+    if (Pacing)
+        paceStart();
+
+    start = clock();
+
+    if (Engine == 0) {
+        // half clock engine, the bus is driven from here
+        void (*half)(void) = DEBUG(1) || TRACING ? emuZ80Trace : emuZ80;
+        uint64_t lastInstruction = MaxInstrictions;
+        uint64_t lastCycles = MaxCycles, lastClocks = MaxClocks;
+        uint32_t waits = 0;
+        uint64_t host = 0;
+        uint16_t insnPc = PC, insnSp = SP;
+
+        while(_halt){
+            uint16_t opcode = ZOpcode;
+            int8_t step = Step;
+
+            // memory read cycle
+            if (_mreq == 0 && _rd == 0)
+                data = memFetch(address);
+
+            // memory write cycle
+            if (_mreq == 0 && _wr == 0)
+                memStore(address, data);
+
+            uint64_t hostStart = Stats == STATS_HOST ? statsHost() : 0;
+            _clk = 1;
+            half();
+            countBus();
+
+            _clk = 0;
+            half();
+            countBus();
+            if (Stats == STATS_HOST)
+                host += statsHost() - hostStart;
+
+            // T states in which _wait held the CPU
+            if (_wait == 0 && Step == step) {
+                z80.count.wait++;
+                waits++;
+            }
+
+            // the opcode statistics and the state after every instruction
+            if (MaxInstrictions != lastInstruction) {
+                lastInstruction = MaxInstrictions;
+                if (Stats) {
+                    statsCount(opcode, MaxCycles - lastCycles, MaxClocks - lastClocks, waits, host);
+                    statsPoll();
+                }
+                if (StateTracing)
+                    stateRecord();
+                if (Profiling)
+                    profileInsn(insnPc, insnSp);
+                if (Covering)
+                    COVER(insnPc);
+                if (MaxClocks >= eventNext)
+                    eventRun();
+                if (Pacing)
+                    paceWait();
+                // the interrupts and the NOPs of HALT, the bus is not driven for them
+                while (intPending && !intStopped() && intService(MaxClocks + 1)) {
+                    if (MaxClocks >= eventNext)
+                        eventRun();
+                    if (Pacing)
+                        paceWait();
+                }
+                insnPc = PC;
+                insnSp = SP;
+                lastCycles = MaxCycles;
+                lastClocks = MaxClocks;
+                waits = 0;
+                host = 0;
+            }
+
+            //printf("\tdata=%d, address=%d, WR=%d, RD=%d",data,address,_wr,_rd);
+            counter++;
+        }
+    }
+    else {
+        // instruction level engine, one call per instruction while tracing,
+        // else the run loop of z80fast.c or the block cache until HALT
+        if (DEBUG(1) || TRACING || StateTracing || Stats || Profiling || Covering || Heating) {
+            while(_halt){
+                uint16_t insnPc = PC, insnSp = SP;
+                stepZ80();
+                if (Profiling)
+                    profileInsn(insnPc, insnSp);
+                if (Covering)
+                    COVER(insnPc);
+                if (StateTracing)
+                    stateRecord();
+                if (Stats)
+                    statsPoll();
+                if (Pacing)
+                    paceWait();
+                while (intPending && !intStopped() && intService(MaxClocks + 1)) {
+                    if (MaxClocks >= eventNext)
+                        eventRun();
+                    if (Pacing)
+                        paceWait();
+                }
+                counter++;
+            }
+        }
+        else {
+            // a HALT that waits for an interrupt stays in runSlices(),
+            // with -m every slice ends with the sleep to its deadline
+            uint32_t slice = Pacing ? paceSlice() : 100000;
+            while(!intStopped()){
+                uint64_t last = MaxInstrictions;
+                if (Engine == 2)
+                    runZ80Block(slice);
+                else
+                    runZ80(slice);
+                counter += MaxInstrictions - last;
+                if (Pacing)
+                    paceWait();
+            }
+        }
+    }
+
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    syncFlagsZ80();
+
+    stateClose();
+    if (!profileClose())
+        printf("\nCannot write the profile %s\n", profileName);
+    if (!coverClose(filelen < 65536 ? (uint32_t)filelen : 65536))
+        printf("\nCannot write the coverage file\n");
+    if (!heatClose())
+        printf("\nCannot write the heat map\n");
+    if (Stats && !statsWrite())
+        printf("\nCannot write the opcode statistics\n");
+    if (Stats == STATS_HOST)
+        statsReport();
+    if (TRACING) {
+        traceClose();
+        printf("\nTrace %s: %llu records, %llu stalled on a full ring, %llu dropped\n", traceName,
+               (unsigned long long)traceRecords, (unsigned long long)traceStalls, (unsigned long long)traceDropped);
+    }
+
+    if (DEBUG(1)){
+        printf("\n\nA=0x%02X, B=0x%02X, C=0x%02X, D=0x%02X, E=0x%02X, H=0x%02X, L=0x%02X, F=0x%02X",A,B,C,D,E,H,L,F);
+        printf("\nA'=0x%02X, B'=0x%02X, C'=0x%02X, D'=0x%02X, E'=0x%02X, H'=0x%02X, L'=0x%02X, F'=0x%02X",A1,B1,C1,D1,E1,H1,L1,F1);
+        printf("\nPC=0x%04X, SP=0x%04X, I=0x%02X, R=0x%02X, IX=0x%04X, IY=0x%04X",PC,SP,I,R,IX, IY);
+        printf("\nMaxCycles M=0x%llX(%llu), MaxClocks T=0x%llX(%llu), MaxInstrictions=0x%llX(%llu)",
+               (unsigned long long)MaxCycles, (unsigned long long)MaxCycles, (unsigned long long)MaxClocks,
+               (unsigned long long)MaxClocks, (unsigned long long)MaxInstrictions, (unsigned long long)MaxInstrictions);
+        printf("\nM cycles: fetch=%llu, memory read=%llu, memory write=%llu, I/O read=%llu, I/O write=%llu, "
+               "interrupt=%llu, refresh=%llu, wait T=%llu, halt=%llu\n\n",
+               (unsigned long long)z80.count.fetch, (unsigned long long)z80.count.memRead,
+               (unsigned long long)z80.count.memWrite, (unsigned long long)z80.count.ioRead,
+               (unsigned long long)z80.count.ioWrite, (unsigned long long)z80.count.intAck,
+               (unsigned long long)z80.count.refresh, (unsigned long long)z80.count.wait,
+               (unsigned long long)z80.count.halt);
+    }
+    if (seconds > 0)
+        printf("Engine %s: %ld calls, %.3f s, %.2f emulated MHz\n", Engine == 2 ? "block" : Engine ? "fast" : "half", counter, seconds, MaxClocks / seconds / 1e6);
+    paceReport();
+
+    return 0;
+}
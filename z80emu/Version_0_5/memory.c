@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "z80.h"
+
+/*
+    Memory map of the emulated board
+
+    0x0000 - 0x7FFF   read from ROM, writes go to VRAM
+    0x8000 - 0xFFFF   RAM
+
+    The map is a table of 256 pages of 256 bytes. A page has a pointer to
+    the host memory it is read from and one to the memory it is written
+    to, a read or write is one lookup in memMap and one access through
+    the pointer. A page without memory for reads or writes calls the
+    device functions of the page instead; memFloat() (the data bus floats
+    high) and memIgnore() are used for the pages that nothing answers, so
+    read-only memory is a page without a write pointer. Both engines and
+    the bus of emuZ80() in main() go through memFetch() and memStore().
+*/
+
+uint8_t rom[32768];
+uint8_t ram[32768];
+uint8_t vram[32768];
+
+z80page memMap[MEM_PAGES];
+
+// reads of pages without memory, a loop that reads a device is not idle (z80fast.c)
+uint64_t memDeviceReads;
+
+// incremented on every write into a 256 byte page that code can be read from,
+// the block cache of z80block.c decodes the blocks of the page again
+uint32_t pageGen[256];
+
+uint8_t memFloat(uint16_t addr) {
+    (void)addr;
+    return 0xFF;
+}
+
+void memIgnore(uint16_t addr, uint8_t value) {
+    (void)addr;
+    (void)value;
+}
+
+// the code of the range changed, the block cache decodes it again
+static void memRemapped(uint16_t addr, uint32_t size) {
+    for (uint32_t a = addr; a < (uint32_t)addr + size; a += 256)
+        pageGen[(a >> 8) & 0xFF]++;
+}
+
+// maps size bytes (a multiple of MEM_PAGE) of host memory at addr, read or write NULL: read floats, writes are ignored
+void memMapMemory(uint16_t addr, uint32_t size, uint8_t *read, uint8_t *write, const char *readName, const char *writeName) {
+    for (uint32_t i = 0; i < size / MEM_PAGE; i++) {
+        z80page *p = &memMap[(addr / MEM_PAGE + i) % MEM_PAGES];
+        p->read = read ? read + i * MEM_PAGE : NULL;
+        p->write = write ? write + i * MEM_PAGE : NULL;
+        p->readDevice = memFloat;
+        p->writeDevice = memIgnore;
+        p->readName = readName;
+        p->writeName = writeName;
+        // a write changes the code of the page
+        p->code = read != NULL && read == write;
+    }
+    memRemapped(addr, size);
+}
+
+// only the read pointers of the pages change, for the bank switching of mmu.c
+void memSwitch(uint16_t addr, uint32_t size, uint8_t *read) {
+    for (uint32_t i = 0; i < size / MEM_PAGE; i++) {
+        z80page *p = &memMap[(addr / MEM_PAGE + i) % MEM_PAGES];
+        p->read = read + i * MEM_PAGE;
+        p->code = p->read == p->write;
+    }
+    memRemapped(addr, size);
+}
+
+// maps a memory mapped device at addr for size bytes, NULL: read floats, writes are ignored
+void memMapDevice(uint16_t addr, uint32_t size, z80readfn read, z80writefn write, const char *name) {
+    for (uint32_t i = 0; i < size / MEM_PAGE; i++) {
+        z80page *p = &memMap[(addr / MEM_PAGE + i) % MEM_PAGES];
+        p->read = NULL;
+        p->write = NULL;
+        p->readDevice = read ? read : memFloat;
+        p->writeDevice = write ? write : memIgnore;
+        p->readName = name;
+        p->writeName = name;
+        p->code = 0;
+    }
+    memRemapped(addr, size);
+}
+
+// the memory map of the board
+void memInit(void) {
+    memMapMemory(0x0000, 32768, rom, vram, "ROM", "VRAM");
+    memMapMemory(0x8000, 32768, ram, ram, "RAM", "RAM");
+}
+
+// memory read cycle of the instructions
+uint8_t memRead(uint16_t addr) {
+    z80.count.memRead++;
+    if (Heating)
+        heatMem[HEAT_READ][addr >> 8]++;
+    return memFetch(addr);
+}
+
+// read that is counted by the caller: opcodes and operands, the bus of emuZ80()
+uint8_t memFetch(uint16_t addr) {
+    const z80page *p = &memMap[addr / MEM_PAGE];
+    uint8_t value;
+
+    if (p->read)
+        value = p->read[addr % MEM_PAGE];
+    else {
+        memDeviceReads++;
+        value = p->readDevice(addr);
+    }
+    if (DEBUG(9))
+        printf("\n\tRead Data=0x%X from %s Address=0x%X",value,p->readName,addr);
+    if (TRACING)
+        traceBus(TRACE_READ, addr, value);
+    return value;
+}
+
+// read without tracing, used by the disassembler, devices are not read
+uint8_t memPeek(uint16_t addr) {
+    const z80page *p = &memMap[addr / MEM_PAGE];
+    return p->read ? p->read[addr % MEM_PAGE] : 0xFF;
+}
+
+// memory write cycle of the instructions
+void memWrite(uint16_t addr, uint8_t value) {
+    z80.count.memWrite++;
+    if (Heating)
+        heatMem[HEAT_WRITE][addr >> 8]++;
+    memStore(addr, value);
+}
+
+// write that is counted by the caller
+void memStore(uint16_t addr, uint8_t value) {
+    const z80page *p = &memMap[addr / MEM_PAGE];
+
+    if (p->write) {
+        p->write[addr % MEM_PAGE] = value;
+        if (p->code)
+            pageGen[addr >> 8]++;
+    }
+    else
+        p->writeDevice(addr, value);
+    if (DEBUG(9))
+        printf("\n\tWrite Data=0x%X to %s Address=0x%X",value,p->writeName,addr);
+    if (TRACING)
+        traceBus(TRACE_WRITE, addr, value);
+}
+
+// no devices are connected yet, the data bus floats high
+uint8_t ioRead(uint16_t port) {
+    z80.count.ioRead++;
+    if (Heating)
+        heatIo[HEAT_READ][port & 0xFF]++;
+    if (DEBUG(9))
+        printf("\n\tRead Data=0xFF from I/O Port=0x%X",port);
+    if (TRACING)
+        traceBus(TRACE_IN, port, 0xFF);
+    return 0xFF;
+}
+
+void ioWrite(uint16_t port, uint8_t value) {
+    z80.count.ioWrite++;
+    if (Heating)
+        heatIo[HEAT_WRITE][port & 0xFF]++;
+    if (Banking)
+        mmuOut(port, value);
+    if (DEBUG(9))
+        printf("\n\tWrite Data=0x%X to I/O Port=0x%X",value,port);
+    if (TRACING)
+        traceBus(TRACE_OUT, port, value);
+}
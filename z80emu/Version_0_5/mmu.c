@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Bank switching of the ROM
+
+    With -k addr/size/latch a window of size KB at addr shows one bank of
+    the ROM image, a write to the latch selects the bank. The latch is an
+    I/O port, or a memory address when it starts with m:
+
+        -k 0x4000/16/0x1F       16 KB at 0x4000, OUT (1Fh) selects the bank
+        -k 0x6000/8/m0x7FFF     8 KB at 0x6000, a write to 7FFFh selects it
+
+    Up to MMU_WINDOWS windows can be given. The ROM image can then be up
+    to MMU_ROM_MAX bytes (256 banks of 16 KB). The addresses of the ROM
+    that are not in a window show the start of the image like without
+    banks, and at reset every window shows the bank at its own address,
+    so the first 32 KB of the image look like a ROM without banks. A
+    smaller image is filled up with zeros to the end of every window.
+
+    A bank switch only changes the read pointers of the pages of the
+    window in memMap (memSwitch()), no memory is copied. Writes into the
+    window still go where the memory map sends them (VRAM on this board).
+    The page of a memory latch calls mmuLatch() for writes, which writes
+    the memory of the page and then selects the bank.
+*/
+
+#define MMU_WINDOWS     4
+
+typedef struct z80window {
+    uint16_t addr;              // first address of the window
+    uint32_t size;              // bytes of a bank
+    uint16_t latch;             // I/O port (low byte) or memory address
+    uint8_t memory;             // the latch is a memory address
+    uint32_t bank;              // selected bank
+} z80window;
+
+int Banking;                            // windows were given with -k
+
+static z80window windows[MMU_WINDOWS];
+static int windowCount;
+static uint8_t *image;                  // the ROM image, mapped by loader.c
+static uint32_t imageSize;              // a multiple of every window size
+static z80page latchPage[MMU_WINDOWS];  // the pages of the memory latches before mmuInit()
+
+// -k addr/size/latch
+int mmuWindow(const char *spec) {
+    z80window w = { 0 };
+    char *end;
+
+    if (windowCount == MMU_WINDOWS)
+        return 0;
+    w.addr = (uint16_t)strtoul(spec, &end, 0);
+    if (*end++ != '/')
+        return 0;
+    w.size = (uint32_t)strtoul(end, &end, 0) * 1024;
+    if (*end++ != '/')
+        return 0;
+    if (*end == 'm') {
+        w.memory = 1;
+        end++;
+    }
+    w.latch = (uint16_t)strtoul(end, &end, 0);
+    if (*end != 0 || w.size == 0 || w.size % MEM_PAGE || w.addr % MEM_PAGE
+            || w.addr + w.size > 65536 || w.addr % w.size)
+        return 0;
+    w.bank = w.addr / w.size;
+    windows[windowCount++] = w;
+    Banking = 1;
+    return 1;
+}
+
+// bytes of the image for a ROM of size bytes, a whole number of banks of every
+// window and at least up to the end of every window for its bank at reset,
+// 0 when that is more than MMU_ROM_MAX
+uint32_t mmuImageSize(size_t size) {
+    uint32_t align = 32768;
+    size_t need = size;
+
+    for (int i = 0; i < windowCount; i++) {
+        if (windows[i].size > align)
+            align = windows[i].size;
+        if (windows[i].addr + windows[i].size > need)
+            need = windows[i].addr + windows[i].size;
+    }
+    need = need ? (need + align - 1) / align * align : align;
+    return need > MMU_ROM_MAX ? 0 : (uint32_t)need;
+}
+
+static void mmuSelect(z80window *w, uint8_t value) {
+    uint32_t bank = value % (imageSize / w->size);
+
+    if (bank == w->bank)
+        return;
+    w->bank = bank;
+    memSwitch(w->addr, w->size, image + w->bank * w->size);
+    if (DEBUG(9))
+        printf("\n\tBank %u at Address=0x%X", w->bank, w->addr);
+}
+
+// write into the page of a memory latch
+static void mmuLatch(uint16_t addr, uint8_t value) {
+    for (int i = 0; i < windowCount; i++) {
+        z80window *w = &windows[i];
+        if (!w->memory || (w->latch / MEM_PAGE) != addr / MEM_PAGE)
+            continue;
+        const z80page *p = &latchPage[i];
+        if (p->write) {
+            p->write[addr % MEM_PAGE] = value;
+            if (p->code)
+                pageGen[addr >> 8]++;
+        }
+        else
+            p->writeDevice(addr, value);
+        if (addr == w->latch)
+            mmuSelect(w, value);
+    }
+}
+
+// maps the image of mmuImageSize() bytes and the windows
+void mmuInit(uint8_t *rom, uint32_t size) {
+    image = rom;
+    imageSize = size;
+    memSwitch(0x0000, 32768, image);
+    for (int i = 0; i < windowCount; i++) {
+        z80window *w = &windows[i];
+        w->bank %= imageSize / w->size;
+        memSwitch(w->addr, w->size, image + w->bank * w->size);
+        if (w->memory) {
+            z80page *p = &memMap[w->latch / MEM_PAGE];
+            if (p->writeDevice != mmuLatch)
+                latchPage[i] = *p;
+            else
+                // two latches in one page, the first one writes the memory
+                latchPage[i] = (z80page){ .writeDevice = memIgnore };
+            p->write = NULL;
+            p->writeDevice = mmuLatch;
+        }
+    }
+}
+
+// OUT to a port, selects the bank of the windows with the port as latch
+void mmuOut(uint16_t port, uint8_t value) {
+    for (int i = 0; i < windowCount; i++)
+        if (!windows[i].memory && (windows[i].latch & 0xFF) == (port & 0xFF))
+            mmuSelect(&windows[i], value);
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+#include "z80.h"
+
+/*
+    Real time pacing
+
+    With -m MHz the emulator runs the Z80 at that clock instead of as fast
+    as it can, for example -m 3.5, -m 4 or -m 8. The engines run in slices
+    of PACE_SLICE_US of emulated time, after every slice paceWait() sleeps
+    with clock_nanosleep() until the host time at which the slice ends.
+    The deadline is computed from the T states since paceStart(), not
+    added up slice by slice, so the error of the sleeps and of the slices
+    that are a few T states longer does not accumulate.
+
+    A slice that ends after its deadline is late, the lateness is
+    counted. When the host falls behind by more than PACE_RESYNC_US (the
+    process was stopped, the host is too slow) the start is moved forward
+    instead of running at full speed until the Z80 has caught up, and the
+    emulated clock is timed again from there.
+
+    paceReport() prints the clock that was reached over the whole run and
+    the lateness of the slices.
+*/
+
+#define PACE_SLICE_US   1000            // emulated time of a slice
+#define PACE_RESYNC_US  100000          // lateness at which the start moves
+
+int Pacing;                             // -m was given
+
+static uint64_t paceHz;                 // target clock
+static uint64_t baseNs, baseClocks;     // host time and MaxClocks of the start
+static uint64_t firstNs, firstClocks;   // of paceStart(), for the report
+static uint64_t paceNext;               // MaxClocks at the end of the slice
+
+static uint64_t slices;                 // slices that were waited for
+static uint64_t lateSlices;             // slices that ended after their deadline
+static uint64_t lateNs;                 // sum of the lateness
+static uint64_t maxLateNs;
+static uint64_t resyncs;                // times the start was moved
+
+static uint64_t paceNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// host time of clocks T states, without an overflow of clocks * 1e9
+static uint64_t paceNs(uint64_t clocks) {
+    return clocks / paceHz * 1000000000u + clocks % paceHz * 1000000000u / paceHz;
+}
+
+// -m MHz
+int paceClock(const char *spec) {
+    char *end;
+    double mhz = strtod(spec, &end);
+
+    if (*end != 0 || mhz < 0.001 || mhz > 10000)
+        return 0;
+    paceHz = (uint64_t)(mhz * 1e6 + 0.5);
+    Pacing = 1;
+    return 1;
+}
+
+// T states of a slice
+uint32_t paceSlice(void) {
+    uint64_t t = paceHz * PACE_SLICE_US / 1000000;
+    return t > 0 ? (uint32_t)t : 1;
+}
+
+// the emulated clock starts now, after the counters were cleared
+void paceStart(void) {
+    firstNs = baseNs = paceNow();
+    firstClocks = baseClocks = MaxClocks;
+    paceNext = MaxClocks + paceSlice();
+}
+
+// after a slice, sleeps until the host time of MaxClocks
+void paceWait(void) {
+    uint64_t deadline, now;
+    struct timespec ts;
+
+    if (MaxClocks < paceNext)
+        return;
+    paceNext = MaxClocks + paceSlice();
+    slices++;
+    deadline = baseNs + paceNs(MaxClocks - baseClocks);
+    now = paceNow();
+    if (now > deadline) {
+        uint64_t late = now - deadline;
+        lateSlices++;
+        lateNs += late;
+        if (late > maxLateNs)
+            maxLateNs = late;
+        if (late > PACE_RESYNC_US * 1000u) {
+            baseNs = now;
+            baseClocks = MaxClocks;
+            resyncs++;
+        }
+        return;
+    }
+    ts.tv_sec = (time_t)(deadline / 1000000000u);
+    ts.tv_nsec = (long)(deadline % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+void paceReport(void) {
+    double seconds = (paceNow() - firstNs) / 1e9;
+
+    if (!Pacing || seconds <= 0)
+        return;
+    printf("Paced at %.3f MHz: %.3f MHz reached in %.3f s, %llu slices of %u T states, "
+           "%llu late (mean %.3f ms, max %.3f ms), %llu resyncs\n",
+           paceHz / 1e6, (MaxClocks - firstClocks) / seconds / 1e6, seconds,
+           (unsigned long long)slices, paceSlice(), (unsigned long long)lateSlices,
+           lateSlices ? lateNs / 1e6 / lateSlices : 0.0, maxLateNs / 1e6, (unsigned long long)resyncs);
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Profiler of the Z80 program
+
+    With -g file the PC is sampled every -i T states (default 1000) at the
+    end of the instruction that was executing. A shadow call stack follows
+    CALL, RST and interrupts into a routine and RET, RETI and RETN out of
+    it, every frame is a node of a call tree and the sample is added to
+    the node of the innermost routine. Two files are written at the end:
+
+        file        the folded stacks of the call tree, one line per stack
+                    "0x0000;0x0040;0x0123 samples", for flame graph tools
+        file.flat   the samples of every address, most samples first,
+                    with the instruction at the address
+
+    The frames are taken apart by SP and not by counting: a RET removes
+    every frame whose return address is below the new SP, so routines that
+    drop their return address or reload SP do not confuse the stack. A
+    call or return is found by the opcode at the PC of the instruction and
+    by SP changing by 2, so a CALL cc or RET cc that is not taken is no
+    frame. profileInsn() is only called while profiling, the engines do not
+    test anything when it is off.
+
+    The NOPs of HALT and the acknowledge cycle of an interrupt are no
+    instruction of the engines, intService() samples them with
+    profileSample() on the HALT or the interrupted instruction.
+*/
+
+#define PROFILE_DEPTH   1024            // frames of the shadow call stack
+#define PROFILE_NODES   (1 << 20)       // routines of the call tree
+
+typedef struct z80node {
+    uint32_t parent;
+    uint32_t child;             // first called routine
+    uint32_t next;              // next routine called by the parent
+    uint16_t addr;              // address of the routine
+    uint64_t samples;           // samples in the routine itself
+} z80node;
+
+typedef struct z80frame {
+    uint32_t node;
+    uint16_t sp;                // SP after the return address was pushed
+} z80frame;
+
+int Profiling;                          // profileInsn() is called after every instruction
+
+static const char *profileName;
+static uint32_t period;
+static uint64_t next;                   // MaxClocks of the next sample
+static uint64_t samples;
+
+static uint64_t flat[65536];            // samples per address
+static z80node *nodes;
+static uint32_t nodeCount;
+static z80frame frames[PROFILE_DEPTH];
+static uint32_t depth;                  // frames[depth - 1] is the current routine
+static uint64_t lost;                   // calls beyond PROFILE_DEPTH or PROFILE_NODES
+
+int profileOpen(const char *name, uint32_t interval) {
+    nodes = calloc(PROFILE_NODES, sizeof(z80node));
+    if (nodes == NULL)
+        return 0;
+    profileName = name;
+    period = interval ? interval : 1;
+    next = MaxClocks + period;
+    memset(flat, 0, sizeof(flat));
+
+    // the root is the routine the CPU starts in
+    nodeCount = 1;
+    nodes[0].addr = PC;
+    frames[0] = (z80frame){ 0, SP };
+    depth = 1;
+    Profiling = 1;
+    return 1;
+}
+
+// node of the routine at addr called from the current routine
+static uint32_t profileChild(uint16_t addr) {
+    uint32_t parent = frames[depth - 1].node;
+    uint32_t n;
+
+    for (n = nodes[parent].child; n; n = nodes[n].next)
+        if (nodes[n].addr == addr)
+            return n;
+    if (nodeCount == PROFILE_NODES)
+        return 0;
+    n = nodeCount++;
+    nodes[n] = (z80node){ .parent = parent, .next = nodes[parent].child, .addr = addr };
+    nodes[parent].child = n;
+    return n;
+}
+
+// sp of a frame compared with SP 0x0000 above 0xFFFF, the stack of a
+// program that starts with LD SP,0 grows down from the top of the memory
+static int profileBelow(uint16_t a, uint16_t b) {
+    return (uint16_t)(a - 1) < (uint16_t)(b - 1);
+}
+
+// removes the frames whose return address is below sp
+static void profileUnwind(uint16_t sp) {
+    while (depth > 1 && profileBelow(frames[depth - 1].sp, sp))
+        depth--;
+}
+
+// the routine at addr was entered, its return address is at sp
+static void profileEnter(uint16_t addr, uint16_t sp) {
+    profileUnwind(sp);
+    if (depth == PROFILE_DEPTH) {
+        lost++;
+        return;
+    }
+    uint32_t n = profileChild(addr);
+    if (n == 0) {
+        lost++;
+        return;
+    }
+    frames[depth++] = (z80frame){ n, sp };
+}
+
+// the samples that are due, on the current routine at pc
+void profileSample(uint16_t pc) {
+    if (MaxClocks >= next) {
+        // an instruction can be longer than the period
+        uint64_t n = (MaxClocks - next) / period + 1;
+        next += n * period;
+        samples += n;
+        flat[pc] += n;
+        nodes[frames[depth - 1].node].samples += n;
+    }
+}
+
+// an interrupt at pc pushed PC and jumped to vector, the acknowledge
+// cycle is sampled on the interrupted routine
+void profileInterrupt(uint16_t pc, uint16_t vector) {
+    profileSample(pc);
+    profileEnter(vector, SP);
+}
+
+// after every instruction, with PC and SP from before it
+void profileInsn(uint16_t pc, uint16_t sp) {
+    uint8_t op = memPeek(pc);
+
+    // CALL nn, CALL cc,nn and RST p
+    if ((op == 0xCD || (op & 0xC7) == 0xC4 || (op & 0xC7) == 0xC7) && SP == (uint16_t)(sp - 2))
+        profileEnter(PC, SP);
+    // RET, RET cc, RETI and RETN
+    else if ((op == 0xC9 || (op & 0xC7) == 0xC0
+              || (op == 0xED && (memPeek((uint16_t)(pc + 1)) & 0xC7) == 0x45)) && SP == (uint16_t)(sp + 2))
+        profileUnwind(SP);
+
+    profileSample(pc);
+}
+
+// the routines from the root to node, separated by ;
+static void profileStack(FILE *fd, uint32_t node) {
+    if (node != 0) {
+        profileStack(fd, nodes[node].parent);
+        fputc(';', fd);
+    }
+    fprintf(fd, "0x%04X", nodes[node].addr);
+}
+
+static int flatOrder(const void *a, const void *b) {
+    uint64_t x = flat[*(const uint16_t *)a], y = flat[*(const uint16_t *)b];
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+int profileClose(void) {
+    static uint16_t order[65536];
+    char text[32];
+    int ok = 1;
+
+    if (!Profiling)
+        return 1;
+    Profiling = 0;
+
+    FILE *fd = fopen(profileName, "w");
+    if (fd != NULL) {
+        for (uint32_t n = 0; n < nodeCount; n++)
+            if (nodes[n].samples) {
+                profileStack(fd, n);
+                fprintf(fd, " %llu\n", (unsigned long long)nodes[n].samples);
+            }
+        ok = fclose(fd) == 0;
+    }
+    else
+        ok = 0;
+
+    size_t len = strlen(profileName);
+    char *flatName = malloc(len + 6);
+    fd = NULL;
+    if (flatName != NULL) {
+        memcpy(flatName, profileName, len);
+        memcpy(flatName + len, ".flat", 6);
+        fd = fopen(flatName, "w");
+    }
+    if (fd != NULL) {
+        uint32_t count = 0;
+        for (uint32_t a = 0; a < 65536; a++)
+            if (flat[a])
+                order[count++] = (uint16_t)a;
+        qsort(order, count, sizeof(order[0]), flatOrder);
+        fprintf(fd, "%llu samples every %u T states\n\n", (unsigned long long)samples, period);
+        for (uint32_t i = 0; i < count; i++) {
+            disasmZ80(order[i], text, sizeof(text));
+            fprintf(fd, "0x%04X %10llu %6.2f%%  %s\n", order[i], (unsigned long long)flat[order[i]],
+                    100.0 * flat[order[i]] / samples, text);
+        }
+        ok = fclose(fd) == 0 && ok;
+    }
+    else
+        ok = 0;
+    free(flatName);
+
+    printf("\nProfile %s: %llu samples in %u routines", profileName, (unsigned long long)samples, nodeCount);
+    if (lost)
+        printf(", %llu calls not in the call tree", (unsigned long long)lost);
+    printf("\n");
+    free(nodes);
+    nodes = NULL;
+    return ok;
+}
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    State trace
+
+    With -s file the state of the CPU after every instruction is written to
+    a file that can hold billions of instructions. A state only holds what
+    changed since the state before:
+
+        mask        2 bytes, bit STATE_... set for every register that changed
+        clocks      T states since the state before, 7 bits per byte
+        pc          difference to the PC before, zigzag, 7 bits per byte
+        registers   2 bytes for AF ... SP and 1 byte for I, R and IFF, in
+                    the order of the mask bits
+
+    R is stored only when it was not incremented by 1 (prefixes, LD R,A).
+    STATE_CHUNK states make a chunk, the first state of a chunk has all
+    bits of the mask set, so a chunk is decoded without the chunks before.
+    Every chunk is compressed by itself with lzPack().
+
+    The file is
+
+        z80stateheader
+        the compressed chunks
+        z80statechunk for every chunk, at header.index
+
+    The header is written again at the end. A viewer maps the file, finds
+    the chunk of instruction N or of a T state in the index with a binary
+    search and only decompresses that chunk, see tools/statedump.c.
+*/
+
+#define STATE_MAX       40              // more than the bytes of the largest state
+
+int StateTracing;                       // stateRecord() is called after every instruction
+
+static FILE *stateFile;
+static z80stateheader header;
+static z80statechunk *chunks;           // the index, written at the end
+static uint32_t chunkSlots;
+
+static uint8_t raw[STATE_CHUNK * STATE_MAX];
+static uint8_t packed[STATE_CHUNK * STATE_MAX + STATE_CHUNK * STATE_MAX / 255 + 16];
+static uint32_t rawLen;                 // bytes of the current chunk
+static uint32_t count;                  // states in the current chunk
+static uint64_t offset;                 // file offset of the next chunk
+
+static uint16_t last[STATE_REGS];       // registers of the state before
+static uint16_t lastPc;
+static uint64_t lastClocks;             // MaxClocks at the state before
+static uint64_t chunkClocks;            // T states at the first state of the chunk
+
+/*
+    Compression of a chunk, LZ77 with the sequences
+
+        token       literals << 4 | (match length - 4), 15 = more bytes follow
+        literals    the bytes of the literals, after the extra length bytes
+        offset      2 bytes, distance of the match
+        match       extra length bytes of the match
+
+    An extra length is a row of 255 and a byte below 255 that are added.
+    The last sequence only has literals, it ends at the end of the chunk.
+*/
+
+#define LZ_HASH         12              // bits of the hash table of lzPack()
+
+static uint32_t lzLength(uint8_t *dst, uint32_t len) {
+    uint32_t n = 0;
+    for (; len >= 255; len -= 255)
+        dst[n++] = 255;
+    dst[n++] = (uint8_t)len;
+    return n;
+}
+
+static uint32_t lzSequence(uint8_t *dst, const uint8_t *lit, uint32_t litLen, uint32_t dist, uint32_t len) {
+    uint32_t n = 1;
+    uint32_t m = len ? len - 4 : 0;
+
+    dst[0] = (uint8_t)((litLen < 15 ? litLen : 15) << 4 | (m < 15 ? m : 15));
+    if (litLen >= 15)
+        n += lzLength(dst + n, litLen - 15);
+    memcpy(dst + n, lit, litLen);
+    n += litLen;
+    if (len) {
+        dst[n++] = (uint8_t)dist;
+        dst[n++] = (uint8_t)(dist >> 8);
+        if (m >= 15)
+            n += lzLength(dst + n, m - 15);
+    }
+    return n;
+}
+
+static uint32_t lzPack(const uint8_t *src, uint32_t len, uint8_t *dst) {
+    static uint32_t table[1 << LZ_HASH];    // position + 1 of the last 4 bytes with the hash
+    uint32_t i = 0, lit = 0, n = 0;
+
+    memset(table, 0, sizeof(table));
+    while (i + 4 <= len) {
+        uint32_t v;
+        memcpy(&v, src + i, 4);
+        uint32_t h = (v * 2654435761u) >> (32 - LZ_HASH);
+        uint32_t match = table[h];
+        table[h] = i + 1;
+
+        if (match && i - (match - 1) <= 65535 && memcmp(src + match - 1, src + i, 4) == 0) {
+            uint32_t from = match - 1, m = 4;
+            while (i + m < len && src[from + m] == src[i + m])
+                m++;
+            n += lzSequence(dst + n, src + lit, i - lit, i - from, m);
+            i += m;
+            lit = i;
+        }
+        else
+            i++;
+    }
+    return n + lzSequence(dst + n, src + lit, len - lit, 0, 0);
+}
+
+// value with 7 bits per byte, the high bit is set when more bytes follow
+static void putVarint(uint32_t v) {
+    while (v >= 0x80) {
+        raw[rawLen++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    raw[rawLen++] = (uint8_t)v;
+}
+
+static void stateFlush(void) {
+    if (count == 0)
+        return;
+    if (header.chunks == chunkSlots) {
+        chunkSlots = chunkSlots ? chunkSlots * 2 : 1024;
+        chunks = realloc(chunks, chunkSlots * sizeof(z80statechunk));
+        if (chunks == NULL) {
+            printf("\nNo memory for the chunk index of the state trace\n");
+            exit(1);
+        }
+    }
+    z80statechunk *chunk = &chunks[header.chunks++];
+    chunk->instruction = header.instructions - count;
+    chunk->clocks = chunkClocks;
+    chunk->offset = offset;
+    chunk->raw = rawLen;
+    chunk->size = lzPack(raw, rawLen, packed);
+    fwrite(packed, 1, chunk->size, stateFile);
+    offset += chunk->size;
+    rawLen = 0;
+    count = 0;
+}
+
+int stateOpen(const char *name) {
+    stateFile = fopen(name, "wb");
+    if (stateFile == NULL)
+        return 0;
+    memset(&header, 0, sizeof(header));
+    header.magic = STATE_MAGIC;
+    fwrite(&header, sizeof(header), 1, stateFile);
+    offset = sizeof(header);
+    lastClocks = MaxClocks;
+    StateTracing = 1;
+    return 1;
+}
+
+void stateRecord(void) {
+    uint16_t regs[STATE_REGS];
+    uint16_t mask = 0;
+
+    syncFlagsZ80();
+    regs[STATE_AF] = (uint16_t)(A << 8 | F);
+    regs[STATE_BC] = BC;
+    regs[STATE_DE] = DE;
+    regs[STATE_HL] = HL;
+    regs[STATE_AF1] = (uint16_t)(A1 << 8 | F1);
+    regs[STATE_BC1] = BC1;
+    regs[STATE_DE1] = DE1;
+    regs[STATE_HL1] = HL1;
+    regs[STATE_IX] = IX;
+    regs[STATE_IY] = IY;
+    regs[STATE_SP] = SP;
+    regs[STATE_I] = I;
+    regs[STATE_R] = R;
+    regs[STATE_IFF] = (uint16_t)((z80.iff1 & 1) | (z80.iff2 & 1) << 1 | (z80.im & 3) << 2);
+
+    uint32_t clocks = (uint32_t)(MaxClocks - lastClocks);
+    header.clocks += clocks;
+    if (count == 0) {
+        // a chunk starts with all registers
+        mask = (1 << STATE_REGS) - 1;
+        chunkClocks = header.clocks;
+        lastPc = 0;
+        clocks = 0;
+    }
+    else {
+        for (int i = 0; i < STATE_REGS; i++)
+            if (regs[i] != last[i])
+                mask |= 1 << i;
+        if (regs[STATE_R] == ((last[STATE_R] & 0x80) | ((last[STATE_R] + 1) & 0x7F)))
+            mask &= ~(1 << STATE_R);
+    }
+
+    raw[rawLen++] = (uint8_t)mask;
+    raw[rawLen++] = (uint8_t)(mask >> 8);
+    putVarint(clocks);
+    int16_t pc = (int16_t)(PC - lastPc);
+    putVarint((uint16_t)(pc < 0 ? ~(pc << 1) : pc << 1));
+    for (int i = 0; i < STATE_REGS; i++)
+        if (mask & (1 << i)) {
+            raw[rawLen++] = (uint8_t)regs[i];
+            if (i < STATE_WORDS)
+                raw[rawLen++] = (uint8_t)(regs[i] >> 8);
+        }
+
+    memcpy(last, regs, sizeof(last));
+    lastPc = PC;
+    lastClocks = MaxClocks;
+    header.instructions++;
+    if (++count == STATE_CHUNK)
+        stateFlush();
+}
+
+void stateClose(void) {
+    if (!StateTracing)
+        return;
+    StateTracing = 0;
+    stateFlush();
+    header.index = offset;
+    fwrite(chunks, sizeof(z80statechunk), header.chunks, stateFile);
+    rewind(stateFile);
+    fwrite(&header, sizeof(header), 1, stateFile);
+    fclose(stateFile);
+    printf("\nState trace: %llu states in %u chunks, %llu bytes\n", (unsigned long long)header.instructions,
+           header.chunks, (unsigned long long)(offset + header.chunks * sizeof(z80statechunk)));
+    free(chunks);
+    chunks = NULL;
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "z80.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <x86intrin.h>
+#define HOST_TSC
+#define HOST_UNIT       "TSC ticks"
+#else
+#define HOST_UNIT       "ns"
+#endif
+
+/*
+    Opcode statistics
+
+    With -c file every executed instruction is counted in the table of its
+    opcode space, with the M cycles, the T states and the wait states it
+    took. The table is written to the file at the end and every time the
+    emulator gets SIGUSR1. A name that ends in .json gives JSON, any other
+    name CSV with one line per opcode that was executed:
+
+        engine,prefix,opcode,count,cycles,clocks,waits,host,host_per_clock
+
+    The opcode is given as in the half clock engine, prefix << 8 | opcode,
+    and prefix << 16 | 0xCB00 | opcode for DDCB and FDCB. The instruction
+    level engine has no wait states, its waits are 0.
+
+    With -p file the host time of every instruction is measured as well,
+    with the time stamp counter on x86 and clock_gettime() elsewhere. It
+    is the time of the two half() calls of every half clock of the
+    instruction, or of stepZ80() for fast and block (the block cache is
+    not used while counting). host_per_clock is the host time per
+    emulated T state, statsReport() prints it for the run and for the
+    opcodes that took the most host time.
+*/
+
+#define STATS_TOP       10              // opcodes printed by statsReport()
+
+enum { SPACE_MAIN, SPACE_CB, SPACE_ED, SPACE_DD, SPACE_FD, SPACE_DDCB, SPACE_FDCB, SPACES };
+
+static const char *const spaceName[SPACES] = { "", "CB", "ED", "DD", "FD", "DDCB", "FDCB" };
+
+typedef struct z80opstat {
+    uint64_t count;             // executions
+    uint64_t cycles;            // M cycles
+    uint64_t clocks;            // T states
+    uint64_t waits;             // wait states
+    uint64_t host;              // host time, HOST_UNIT
+} z80opstat;
+
+int Stats;                              // statsCount() is called after every instruction, STATS_HOST with the host time
+
+static z80opstat opStats[SPACES][256];
+static const char *statsName;
+static volatile sig_atomic_t statsRequest;  // SIGUSR1 was received
+
+static void statsSignal(int sig) {
+    (void)sig;
+    statsRequest = 1;
+}
+
+void statsOpen(const char *name, int mode) {
+    statsName = name;
+    memset(opStats, 0, sizeof(opStats));
+#ifdef SIGUSR1
+    signal(SIGUSR1, statsSignal);
+#endif
+    Stats = mode;
+}
+
+// time stamp of the host, HOST_UNIT
+uint64_t statsHost(void) {
+#ifdef HOST_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void statsCount(uint32_t opcode, uint32_t cycles, uint32_t clocks, uint32_t waits, uint64_t host) {
+    int space;
+
+    switch (opcode >> 8) {
+        case 0xCB: space = SPACE_CB; break;
+        case 0xED: space = SPACE_ED; break;
+        case 0xDD: space = SPACE_DD; break;
+        case 0xFD: space = SPACE_FD; break;
+        case 0xDDCB: space = SPACE_DDCB; break;
+        case 0xFDCB: space = SPACE_FDCB; break;
+        default: space = SPACE_MAIN; break;
+    }
+    z80opstat *s = &opStats[space][opcode & 0xFF];
+    s->count++;
+    s->cycles += cycles;
+    s->clocks += clocks;
+    s->waits += waits;
+    s->host += host;
+}
+
+void statsInsn(const z80insn *in, uint32_t cycles, uint32_t clocks, uint64_t host) {
+    uint32_t opcode = (uint32_t)in->prefix << 8 | in->op;
+
+    if ((in->prefix == 0xDD || in->prefix == 0xFD) && memPeek((uint16_t)(in->pc + 1)) == 0xCB)
+        opcode = (uint32_t)in->prefix << 16 | 0xCB00 | in->op;
+    statsCount(opcode, cycles, clocks, 0, host);
+}
+
+static const char *engineName(void) {
+    return Engine == 2 ? "block" : Engine ? "fast" : "half";
+}
+
+int statsWrite(void) {
+    FILE *fd = fopen(statsName, "w");
+    size_t len = strlen(statsName);
+    int json = len >= 5 && strcmp(statsName + len - 5, ".json") == 0;
+    int first = 1;
+
+    if (fd == NULL)
+        return 0;
+    fprintf(fd, json ? "[\n" : "engine,prefix,opcode,count,cycles,clocks,waits,host,host_per_clock\n");
+    for (int space = 0; space < SPACES; space++)
+        for (int op = 0; op < 256; op++) {
+            const z80opstat *s = &opStats[space][op];
+            if (s->count == 0)
+                continue;
+            double perClock = s->clocks ? (double)s->host / s->clocks : 0;
+            if (json)
+                fprintf(fd, "%s  {\"engine\": \"%s\", \"prefix\": \"%s\", \"opcode\": \"%02X\", \"count\": %llu, \"cycles\": %llu, "
+                        "\"clocks\": %llu, \"waits\": %llu, \"host\": %llu, \"host_per_clock\": %.3f}",
+                        first ? "" : ",\n", engineName(), spaceName[space], op, (unsigned long long)s->count,
+                        (unsigned long long)s->cycles, (unsigned long long)s->clocks, (unsigned long long)s->waits,
+                        (unsigned long long)s->host, perClock);
+            else
+                fprintf(fd, "%s,%s,%02X,%llu,%llu,%llu,%llu,%llu,%.3f\n", engineName(), spaceName[space], op,
+                        (unsigned long long)s->count, (unsigned long long)s->cycles, (unsigned long long)s->clocks,
+                        (unsigned long long)s->waits, (unsigned long long)s->host, perClock);
+            first = 0;
+        }
+    if (json)
+        fprintf(fd, "%s]\n", first ? "" : "\n");
+    return fclose(fd) == 0;
+}
+
+// host time per T state of the run and of the opcodes that took the most host time
+void statsReport(void) {
+    const z80opstat *top[STATS_TOP] = { 0 };
+    int topSpace[STATS_TOP] = { 0 }, topOp[STATS_TOP] = { 0 };
+    uint64_t host = 0, clocks = 0;
+
+    for (int space = 0; space < SPACES; space++)
+        for (int op = 0; op < 256; op++) {
+            const z80opstat *s = &opStats[space][op];
+            host += s->host;
+            clocks += s->clocks;
+
+            // insertion into the list, the most host time first
+            int i = STATS_TOP;
+            while (i > 0 && (top[i - 1] == NULL || top[i - 1]->host < s->host))
+                i--;
+            if (i == STATS_TOP || s->host == 0)
+                continue;
+            for (int j = STATS_TOP - 1; j > i; j--) {
+                top[j] = top[j - 1];
+                topSpace[j] = topSpace[j - 1];
+                topOp[j] = topOp[j - 1];
+            }
+            top[i] = s;
+            topSpace[i] = space;
+            topOp[i] = op;
+        }
+    if (clocks == 0 || host == 0)
+        return;
+
+    printf("\nHost time of %s: %.2f %s per T state\n", engineName(), (double)host / clocks, HOST_UNIT);
+    for (int i = 0; i < STATS_TOP && top[i]; i++)
+        printf("  %4s %02X  %5.1f%%  %8.2f per T state, %llu times\n", spaceName[topSpace[i]], topOp[i],
+               100.0 * top[i]->host / host, (double)top[i]->host / top[i]->clocks, (unsigned long long)top[i]->count);
+}
+
+// writes the table when SIGUSR1 was received, called between instructions
+void statsPoll(void) {
+    if (statsRequest) {
+        statsRequest = 0;
+        statsWrite();
+    }
+}
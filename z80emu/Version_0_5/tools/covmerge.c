@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../z80.h"
+
+/*
+    covmerge - adds the coverage maps of z80emu -v together
+
+        covmerge [-l rom_file] out_file in_file ...
+
+    out_file gets every address that is set in one of the in_files. With
+    -l the listing of the ROM against the sum is printed, like the .lst
+    file that z80emu writes for one run.
+
+    To compile it in Version_0_5:
+    gcc -O2 -o covmerge tools/covmerge.c cover.c disasm.c
+*/
+
+static uint8_t memory[65536];
+
+uint8_t memPeek(uint16_t addr) {
+    return memory[addr];
+}
+
+int main(int argc, char *argv[]) {
+    static z80cover sum, cov;
+    char *romName = NULL;
+    int i = 1;
+
+    if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+        romName = argv[i + 1];
+        i += 2;
+    }
+    if (argc - i < 2) {
+        printf("Usage: %s [-l rom_file] out_file in_file ...\n", argv[0]);
+        return 1;
+    }
+
+    const char *outName = argv[i++];
+    sum.magic = COVER_MAGIC;
+    for (; i < argc; i++) {
+        if (!coverLoad(argv[i], &cov)) {
+            printf("%s is not a coverage file\n", argv[i]);
+            return 1;
+        }
+        for (size_t b = 0; b < sizeof(sum.start); b++) {
+            sum.start[b] |= cov.start[b];
+            sum.op[b] |= cov.op[b];
+            sum.arg[b] |= cov.arg[b];
+        }
+    }
+    if (!coverSave(outName, &sum)) {
+        printf("Cannot write %s\n", outName);
+        return 1;
+    }
+
+    if (romName != NULL) {
+        FILE *fd = fopen(romName, "rb");
+        if (fd == NULL) {
+            printf("File %s not found!\n", romName);
+            return 1;
+        }
+        size_t len = fread(memory, 1, sizeof(memory), fd);
+        fclose(fd);
+        coverListing(stdout, &sum, (uint32_t)len);
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../z80.h"
+
+/*
+    statedump - prints the states of a state file of z80emu -s
+
+    The file is mapped into memory, only the header, the chunk index and
+    the chunk with the first state that is printed are read:
+
+        -n N    start at instruction N (0 is the state after the first one)
+        -c T    start at the first state at or after T state T
+        -k K    print K states (default all)
+
+    To compile it in Version_0_5:
+    gcc -O2 -o statedump tools/statedump.c
+*/
+
+static const z80statechunk *chunks;
+static const z80stateheader *header;
+
+static uint8_t raw[STATE_CHUNK * 40];
+
+// inverse of lzPack() of statetrace.c, returns the bytes of the chunk
+static uint32_t lzUnpack(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t max) {
+    const uint8_t *end = src + size;
+    uint32_t n = 0;
+
+    while (src < end) {
+        uint8_t token = *src++;
+        uint32_t len = token >> 4;
+        if (len == 15)
+            do len += *src; while (*src++ == 255);
+        if (n + len > max || src + len > end)
+            return 0;
+        memcpy(dst + n, src, len);
+        src += len;
+        n += len;
+        if (src >= end)
+            break;
+
+        uint32_t dist = src[0] | src[1] << 8;
+        src += 2;
+        len = (token & 15) + 4;
+        if ((token & 15) == 15)
+            do len += *src; while (*src++ == 255);
+        if (dist == 0 || dist > n || n + len > max)
+            return 0;
+        for (uint32_t i = 0; i < len; i++, n++)
+            dst[n] = dst[n - dist];
+    }
+    return n;
+}
+
+static uint32_t getVarint(const uint8_t **p) {
+    uint32_t v = 0;
+    int shift = 0;
+    uint8_t b;
+
+    do {
+        b = *(*p)++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+// first chunk of the index that holds the state
+static uint32_t findChunk(uint64_t instruction, uint64_t clocks, int byClocks) {
+    uint32_t lo = 0, hi = header->chunks;
+
+    // last chunk that starts at or before the state
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (byClocks ? chunks[mid].clocks <= clocks : chunks[mid].instruction <= instruction)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int main(int argc, char *argv[]) {
+    char *stateName = NULL;
+    uint64_t first = 0, clocksFirst = 0, limit = UINT64_MAX;
+    int byClocks = 0;
+    struct stat st;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            first = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            clocksFirst = strtoull(argv[++i], NULL, 0);
+            byClocks = 1;
+        }
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            limit = strtoull(argv[++i], NULL, 0);
+        else if (stateName == NULL && argv[i][0] != '-')
+            stateName = argv[i];
+        else {
+            stateName = NULL;
+            break;
+        }
+    }
+    if (stateName == NULL) {
+        printf("Usage: %s [-n instruction | -c clocks] [-k count] state_file\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(stateName, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("File %s not found!\n", stateName);
+        return 1;
+    }
+    const uint8_t *file = st.st_size >= (off_t)sizeof(z80stateheader)
+        ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (file == MAP_FAILED) {
+        printf("Cannot map %s\n", stateName);
+        return 1;
+    }
+    header = (const z80stateheader *)file;
+    if (header->magic != STATE_MAGIC
+            || header->index + (uint64_t)header->chunks * sizeof(z80statechunk) > (uint64_t)st.st_size) {
+        printf("%s is not a complete state file\n", stateName);
+        return 1;
+    }
+    chunks = (const z80statechunk *)(file + header->index);
+    printf("%llu states, %llu T states, %u chunks\n", (unsigned long long)header->instructions,
+           (unsigned long long)header->clocks, header->chunks);
+
+    uint16_t regs[STATE_REGS] = { 0 };
+    uint16_t pc = 0;
+    uint64_t clocks = 0;
+
+    for (uint32_t c = findChunk(first, clocksFirst, byClocks); c < header->chunks && limit > 0; c++) {
+        const z80statechunk *chunk = &chunks[c];
+        if (chunk->offset + chunk->size > (uint64_t)st.st_size
+                || lzUnpack(file + chunk->offset, chunk->size, raw, sizeof(raw)) != chunk->raw) {
+            printf("Chunk %u is damaged\n", c);
+            return 1;
+        }
+
+        const uint8_t *p = raw;
+        uint64_t n = chunk->instruction;
+        clocks = chunk->clocks;
+        pc = 0;
+        for (; p < raw + chunk->raw && limit > 0; n++) {
+            uint16_t mask = (uint16_t)(p[0] | p[1] << 8);
+            p += 2;
+            clocks += getVarint(&p);
+            uint16_t zz = (uint16_t)getVarint(&p);
+            pc += (zz & 1) ? ~(zz >> 1) : zz >> 1;
+            if (!(mask & (1 << STATE_R)))
+                regs[STATE_R] = (regs[STATE_R] & 0x80) | ((regs[STATE_R] + 1) & 0x7F);
+            for (int i = 0; i < STATE_REGS; i++)
+                if (mask & (1 << i)) {
+                    regs[i] = *p++;
+                    if (i < STATE_WORDS)
+                        regs[i] |= *p++ << 8;
+                }
+
+            if (byClocks ? clocks < clocksFirst : n < first)
+                continue;
+            printf("%llu T=%llu PC=0x%04X ==> A=0x%02X, F=0x%02X, BC=0x%04X, DE=0x%04X, HL=0x%04X, SP=0x%04X, IX=0x%04X, IY=0x%04X, I=0x%02X, R=0x%02X\n",
+                   (unsigned long long)n, (unsigned long long)clocks, pc, regs[STATE_AF] >> 8, regs[STATE_AF] & 0xFF,
+                   regs[STATE_BC], regs[STATE_DE], regs[STATE_HL], regs[STATE_SP], regs[STATE_IX], regs[STATE_IY],
+                   regs[STATE_I], regs[STATE_R]);
+            limit--;
+        }
+    }
+    return 0;
+}
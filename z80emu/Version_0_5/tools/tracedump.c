@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../z80.h"
+
+/*
+    tracedump - prints a binary trace file of z80emu -t
+
+    The records are printed in the text format of the debug levels of the
+    emulator, -d selects the level like in z80emu:
+
+        1   disassembled instructions (7: with PC)
+        4   Opcode, 5 Step, 6 Clk, 7 PC of every half clock
+        8   the control signals of the half clock, registers after an instruction
+        9   memory and I/O cycles
+
+    To compile it in Version_0_5:
+    gcc -O2 -o tracedump tools/tracedump.c disasm.c
+*/
+
+int Debug = 9;
+
+// read and write names of the pages of the memory map, from the header
+static char names[2][MEM_PAGES][TRACE_NAME];
+
+// the instruction of the last TRACE_INSN record, read by the disassembler
+static uint16_t insnPc;
+static uint8_t insnBytes[4];
+
+uint8_t memPeek(uint16_t addr) {
+    uint16_t i = (uint16_t)(addr - insnPc);
+    return i < sizeof(insnBytes) ? insnBytes[i] : 0;
+}
+
+static void printRecord(const z80trace *rec) {
+    char text[32];
+
+    switch (rec->kind) {
+        case TRACE_INSN:
+            if (Debug < 1)
+                break;
+            insnPc = rec->pc;
+            memcpy(insnBytes, rec->bytes, sizeof(insnBytes));
+            disasmZ80(rec->pc, text, sizeof(text));
+            if (Debug >= 7)
+                printf("\n\nPC = 0x%04X -- %s", rec->pc, text);
+            else
+                printf("\n\n%s", text);
+            break;
+        case TRACE_REGS:
+            if (Debug >= 8)
+                printf(" ==> A=0x%02X, F=0x%02X, BC=0x%04X, DE=0x%04X, HL=0x%04X, SP=0x%04X, IX=0x%04X, IY=0x%04X",
+                       rec->af >> 8, rec->af & 0xFF, rec->bc, rec->de, rec->hl, rec->sp, rec->ix, rec->iy);
+            break;
+        case TRACE_CLOCK:
+            if (Debug >= 4)
+                printf("\n  Opcode = 0x%04X, ", rec->opcode);
+            if (Debug >= 5)
+                printf("Step = %d, ", rec->step);
+            if (Debug >= 6)
+                printf("Clk = %d, ", rec->pins & PIN_CLK ? 1 : 0);
+            if (Debug >= 7)
+                printf("PC = 0x%X -- ", rec->pc);
+            if (Debug >= 8)
+                printf("_M1=%d _MREQ=%d _RD=%d _WR=%d _RFSH=%d ",
+                       rec->pins & PIN_M1 ? 1 : 0, rec->pins & PIN_MREQ ? 1 : 0, rec->pins & PIN_RD ? 1 : 0,
+                       rec->pins & PIN_WR ? 1 : 0, rec->pins & PIN_RFSH ? 1 : 0);
+            break;
+        case TRACE_READ:
+            if (Debug >= 9)
+                printf("\n\tRead Data=0x%X from %s Address=0x%X", rec->data, names[0][rec->address / MEM_PAGE], rec->address);
+            break;
+        case TRACE_WRITE:
+            if (Debug >= 9)
+                printf("\n\tWrite Data=0x%X to %s Address=0x%X", rec->data, names[1][rec->address / MEM_PAGE], rec->address);
+            break;
+        case TRACE_IN:
+            if (Debug >= 9)
+                printf("\n\tRead Data=0x%X from I/O Port=0x%X", rec->data, rec->address);
+            break;
+        case TRACE_OUT:
+            if (Debug >= 9)
+                printf("\n\tWrite Data=0x%X to I/O Port=0x%X", rec->data, rec->address);
+            break;
+        default:
+            printf("\nUnknown record %d", rec->kind);
+            break;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char *traceName = NULL;
+    uint32_t header[3];
+    z80trace rec;
+    FILE *fd;
+    long count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            Debug = atoi(argv[++i]);
+        else if (traceName == NULL && argv[i][0] != '-')
+            traceName = argv[i];
+        else {
+            printf("Usage: %s [-d debug_level] trace_file\n", argv[0]);
+            return 1;
+        }
+    }
+    if (traceName == NULL) {
+        printf("Usage: %s [-d debug_level] trace_file\n", argv[0]);
+        return 1;
+    }
+
+    fd = fopen(traceName, "rb");
+    if (fd == NULL) {
+        printf("File %s not found!\n", traceName);
+        return 1;
+    }
+    if (fread(header, sizeof(header), 1, fd) != 1 || header[0] != TRACE_MAGIC || header[1] != TRACE_VERSION
+            || header[2] != sizeof(z80trace) || fread(names, sizeof(names), 1, fd) != 1) {
+        printf("%s is not a trace file of this version\n", traceName);
+        fclose(fd);
+        return 1;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, fd) == 1) {
+        printRecord(&rec);
+        count++;
+    }
+    fclose(fd);
+
+    printf("\n\n%ld records\n", count);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "z80.h"
+
+/*
+    Binary trace
+
+    With -t file the engines write a fixed size record (z80trace) for every
+    instruction, half clock and bus cycle without formatting text. The
+    records go into a ring buffer with one producer, the emulator, and one
+    consumer, a writer thread that copies them to the file. head and tail
+    are only written by their own side, so no lock is needed.
+
+    The emulator only waits when the ring is full, traceStalls counts the
+    records that had to wait. traceDropped counts the records the writer
+    could not write to the file. tracedump (tools/tracedump.c) prints a
+    trace file in the text format of the debug levels.
+
+    After the first words the header has the read and then the write name
+    of every page of memMap, TRACE_NAME bytes each, so tracedump names the
+    memory of a cycle like the debug output does. It is the map at
+    traceOpen(), after the image and the banks were loaded.
+*/
+
+#define TRACE_RING      65536           // records in the ring, a power of 2
+
+int Tracing;                            // records are written to the ring
+
+uint64_t traceRecords;
+uint64_t traceStalls;
+uint64_t traceDropped;
+
+static z80trace ring[TRACE_RING];
+static atomic_uint head;                // next record of the emulator
+static atomic_uint tail;                // next record of the writer
+static atomic_int done;                 // traceClose() was called
+static FILE *traceFile;
+static pthread_t writer;
+
+static void *traceWriter(void *arg) {
+    struct timespec idle = { 0, 100000 };
+
+    (void)arg;
+    for (;;) {
+        unsigned t = atomic_load_explicit(&tail, memory_order_relaxed);
+        unsigned h = atomic_load_explicit(&head, memory_order_acquire);
+
+        if (h == t) {
+            if (atomic_load_explicit(&done, memory_order_acquire)
+                    && h == atomic_load_explicit(&head, memory_order_acquire))
+                return NULL;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        // the records up to head or up to the end of the ring
+        unsigned n = h - t;
+        unsigned first = t & (TRACE_RING - 1);
+        if (n > TRACE_RING - first)
+            n = TRACE_RING - first;
+        size_t written = fwrite(&ring[first], sizeof(z80trace), n, traceFile);
+        traceDropped += n - written;
+        atomic_store_explicit(&tail, t + n, memory_order_release);
+    }
+}
+
+int traceOpen(const char *name) {
+    static char names[2][MEM_PAGES][TRACE_NAME];
+    uint32_t header[3] = { TRACE_MAGIC, TRACE_VERSION, sizeof(z80trace) };
+
+    for (int i = 0; i < MEM_PAGES; i++) {
+        strncpy(names[0][i], memMap[i].readName ? memMap[i].readName : "", TRACE_NAME - 1);
+        strncpy(names[1][i], memMap[i].writeName ? memMap[i].writeName : "", TRACE_NAME - 1);
+    }
+    traceFile = fopen(name, "wb");
+    if (traceFile == NULL)
+        return 0;
+    fwrite(header, sizeof(header), 1, traceFile);
+    fwrite(names, sizeof(names), 1, traceFile);
+    if (pthread_create(&writer, NULL, traceWriter, NULL) != 0) {
+        fclose(traceFile);
+        return 0;
+    }
+    Tracing = 1;
+    return 1;
+}
+
+// waits for the writer to empty the ring
+void traceClose(void) {
+    if (!Tracing)
+        return;
+    Tracing = 0;
+    atomic_store_explicit(&done, 1, memory_order_release);
+    pthread_join(writer, NULL);
+    fclose(traceFile);
+}
+
+// the next free record, waits while the ring is full
+static z80trace *traceSlot(void) {
+    unsigned h = atomic_load_explicit(&head, memory_order_relaxed);
+
+    if (h - atomic_load_explicit(&tail, memory_order_acquire) == TRACE_RING) {
+        traceStalls++;
+        while (h - atomic_load_explicit(&tail, memory_order_acquire) == TRACE_RING)
+            sched_yield();
+    }
+
+    // the fields of the other kinds are 0, the file does not depend on old records
+    z80trace *rec = &ring[h & (TRACE_RING - 1)];
+    *rec = (z80trace){
+        .clocks = (uint32_t)MaxClocks,
+        .pc = PC,
+        .address = address,
+        .opcode = ZOpcode,
+        .data = data,
+        .step = (uint8_t)Step,
+        .pins = (_clk ? PIN_CLK : 0) | (_m1 ? PIN_M1 : 0) | (_mreq ? PIN_MREQ : 0)
+              | (_rd ? PIN_RD : 0) | (_wr ? PIN_WR : 0) | (_rfsh ? PIN_RFSH : 0)
+              | (_halt ? PIN_HALT : 0)
+    };
+    return rec;
+}
+
+// the record is complete, the writer can take it
+static void tracePush(void) {
+    atomic_store_explicit(&head, atomic_load_explicit(&head, memory_order_relaxed) + 1,
+                          memory_order_release);
+    traceRecords++;
+}
+
+void traceBus(int kind, uint16_t addr, uint8_t value) {
+    z80trace *rec = traceSlot();
+    rec->kind = (uint8_t)kind;
+    rec->address = addr;
+    rec->data = value;
+    tracePush();
+}
+
+void traceClock(void) {
+    z80trace *rec = traceSlot();
+    rec->kind = TRACE_CLOCK;
+    tracePush();
+}
+
+void traceInsn(void) {
+    z80trace *rec = traceSlot();
+    rec->kind = TRACE_INSN;
+    for (int i = 0; i < 4; i++)
+        rec->bytes[i] = memPeek((uint16_t)(PC + i));
+    tracePush();
+}
+
+void traceRegs(void) {
+    syncFlagsZ80();
+    z80trace *rec = traceSlot();
+    rec->kind = TRACE_REGS;
+    rec->af = (uint16_t)(A << 8 | F);
+    rec->bc = BC;
+    rec->de = DE;
+    rec->hl = HL;
+    rec->sp = SP;
+    rec->ix = IX;
+    rec->iy = IY;
+    tracePush();
+}
@@ -0,0 +1,530 @@
+#ifndef Z80_H
+#define Z80_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// build option: -DZ80_THREADED=0 uses the switch dispatch even with GCC and Clang
+#ifndef Z80_THREADED
+#if defined(__GNUC__)
+#define Z80_THREADED 1
+#else
+#define Z80_THREADED 0
+#endif
+#endif
+
+// build option: -DZ80_LAZY_FLAGS=1 computes F of the 8 bit ALU instructions only when it is used
+#ifndef Z80_LAZY_FLAGS
+#define Z80_LAZY_FLAGS 0
+#endif
+
+// build option: -DZ80_TRACE=n keeps the trace output of the debug levels 1 to n,
+// -DZ80_TRACE=0 is a release build without any of it
+#ifndef Z80_TRACE
+#define Z80_TRACE 9
+#endif
+
+// debug level n is on, a constant 0 above Z80_TRACE so the code is removed
+#define DEBUG(n) ((n) <= Z80_TRACE && Debug >= (n))
+
+// the binary trace of trace.c is written, a constant 0 with -DZ80_TRACE=0
+#define TRACING (Z80_TRACE > 0 && Tracing)
+
+/*
+    Shared state of the Z80 emulator.
+
+    The register file and the bus signals are used both by the half clock
+    engine emuZ80() in main.c and by the instruction level engine in z80fast.c
+*/
+
+extern int Debug;
+extern int Wait;
+extern long Limit;
+extern int Engine;
+extern int Jit;
+extern int Tracing;
+
+/*
+    Counters of the run, 64 bit so they do not wrap. They are plain fields of
+    z80, another thread or a signal handler can read them while the engines
+    run (one aligned load per counter). An M cycle is counted by its type:
+    the operand bytes of an instruction are memory reads, every M1 cycle is
+    followed by a refresh.
+*/
+typedef struct z80counters {
+    uint64_t instructions;      // MaxInstrictions
+    uint64_t cycles;            // MaxCycles, all M cycles
+    uint64_t clocks;            // MaxClocks, all T states
+    uint64_t fetch;             // M1 opcode fetch cycles
+    uint64_t memRead;           // memory read cycles, operands and data
+    uint64_t memWrite;          // memory write cycles
+    uint64_t ioRead;            // I/O read cycles
+    uint64_t ioWrite;           // I/O write cycles
+    uint64_t intAck;            // interrupt acknowledge cycles
+    uint64_t refresh;           // refresh cycles
+    uint64_t wait;              // wait states, T states
+    uint64_t halt;              // M1 cycles executed while halted
+} z80counters;
+
+typedef struct z80status
+{
+    // register file: two banks of C, B, E, D, L, H, A, F. The 3 bit
+    // register field r of an opcode is at index r ^ 1 (A is 7, F takes the
+    // place of (HL)), BC, DE and HL are the 16 bit pairs 0, 1 and 2
+    union {
+        uint8_t r8[8];
+        uint16_t r16[4];
+    } regs[2];
+
+    uint8_t bank;       // bank of BC, DE and HL, EXX flips it
+    uint8_t bankAF;     // bank of A and F, EX AF,AF' flips it
+
+    //  registers I and R
+    union {
+        struct {
+            uint8_t r;
+            uint8_t i;
+        };
+        uint16_t ir;
+    }ir;
+
+    //  stack pointer
+    union {
+        struct {
+            uint8_t spl;
+            uint8_t sph;
+        };
+        uint16_t sp;
+    }sp;
+
+    //  instruction opcode
+    union {
+        struct {
+            uint8_t opcode_l;
+            uint8_t opcode_h;
+        };
+        uint16_t opcode;
+    }op;
+
+    //  register IX
+    union {
+        struct {
+            uint8_t ixl;
+            uint8_t ixh;
+        };
+        uint16_t ix;
+    }ix;
+
+    //  register IY
+    union {
+        struct {
+            uint8_t iyl;
+            uint8_t iyh;
+        };
+        uint16_t iy;
+    }iy;
+
+    uint16_t z_pc;
+    //uint16_t z_ix;
+    //uint16_t z_iy;
+    int8_t z_cycles;    // M cycles
+    int8_t z_step;      // T steps
+	int8_t z_operand;
+	z80counters count;
+
+    int8_t iff1;        // Interrupt flip flops
+    int8_t iff2;
+    int8_t im;          // Interrupt mode
+
+    int8_t z_temp8;
+
+} z80status;
+
+extern z80status z80;
+
+// registers of the current banks, REG8(r) and REG16(p) take the fields of the opcode
+#define REG8(r) z80.regs[((r) & 6) == 6 ? z80.bankAF : z80.bank].r8[(r) ^ 1]
+#define REG16(p) z80.regs[z80.bank].r16[p]
+
+#define A z80.regs[z80.bankAF].r8[6]
+#define A1 z80.regs[z80.bankAF ^ 1].r8[6]
+#define F z80.regs[z80.bankAF].r8[7]
+#define F1 z80.regs[z80.bankAF ^ 1].r8[7]
+#define B z80.regs[z80.bank].r8[1]
+#define B1 z80.regs[z80.bank ^ 1].r8[1]
+#define C z80.regs[z80.bank].r8[0]
+#define C1 z80.regs[z80.bank ^ 1].r8[0]
+#define BC z80.regs[z80.bank].r16[0]
+#define BC1 z80.regs[z80.bank ^ 1].r16[0]
+#define D z80.regs[z80.bank].r8[3]
+#define D1 z80.regs[z80.bank ^ 1].r8[3]
+#define E z80.regs[z80.bank].r8[2]
+#define E1 z80.regs[z80.bank ^ 1].r8[2]
+#define DE z80.regs[z80.bank].r16[1]
+#define DE1 z80.regs[z80.bank ^ 1].r16[1]
+#define H z80.regs[z80.bank].r8[5]
+#define H1 z80.regs[z80.bank ^ 1].r8[5]
+#define L z80.regs[z80.bank].r8[4]
+#define L1 z80.regs[z80.bank ^ 1].r8[4]
+#define HL z80.regs[z80.bank].r16[2]
+#define HL1 z80.regs[z80.bank ^ 1].r16[2]
+#define I z80.ir.i
+#define R z80.ir.r
+#define IR z80.ir.ir
+
+#define PC z80.z_pc
+#define SPH z80.sp.sph
+#define SPL z80.sp.spl
+#define SP z80.sp.sp
+#define IX z80.ix.ix
+#define IXH z80.ix.ixh
+#define IXL z80.ix.ixl
+#define IY z80.iy.iy
+#define IYH z80.iy.iyh
+#define IYL z80.iy.iyl
+#define Cycles z80.z_cycles
+#define Step z80.z_step
+#define ZOpcode z80.op.opcode
+#define ZOpcodeL z80.op.opcode_l
+#define ZOpcodeH z80.op.opcode_h
+#define ZOperand z80.z_operand
+#define ZTemp8 z80.z_temp8
+#define MaxCycles z80.count.cycles
+#define MaxClocks z80.count.clocks
+#define MaxInstrictions z80.count.instructions
+
+// the counters of one instruction of the instruction level engine: M cycles,
+// T states, length and M1 cycles. The bytes that are not fetched in M1 are
+// operands read in memory read cycles, the data is counted by memRead()...
+#define COUNT_INSN(m, t, len, m1) do { \
+        z80.count.instructions++; \
+        z80.count.cycles += (m); \
+        z80.count.clocks += (t); \
+        z80.count.fetch += (m1); \
+        z80.count.refresh += (m1); \
+        z80.count.memRead += (len) - (m1); \
+    } while (0)
+
+extern uint16_t address;       // Address Bus
+extern uint8_t data;           // Data Bus
+
+// control signals
+extern uint8_t _m1; 	        // out
+extern uint8_t _mreq;          // out
+extern uint8_t _ireq;          // out
+extern uint8_t _rd;            // out
+extern uint8_t _wr;            // out
+extern uint8_t _rfsh;          // out
+extern uint8_t _halt;          // out
+extern uint8_t _wait;          // in
+extern uint8_t _int;           // in
+extern uint8_t _nmi;           // in
+extern uint8_t _reset;         // in
+extern uint8_t _busrq;         // in
+extern uint8_t _busack;        // out
+extern uint8_t _clk;           // in
+//TO DO: make them boolean
+
+// bits of the flag register F
+#define FLAG_C  0x01            // Carry
+#define FLAG_N  0x02            // Add/Subtract
+#define FLAG_PV 0x04            // Parity/Overflow
+#define FLAG_3  0x08
+#define FLAG_H  0x10            // Half Carry
+#define FLAG_5  0x20
+#define FLAG_Z  0x40            // Zero
+#define FLAG_S  0x80            // Sign
+
+// one decoded instruction of the instruction level engine
+typedef struct z80insn z80insn;
+typedef void (*z80handler)(const z80insn *in);
+
+struct z80insn {
+    z80handler handler;         // function that executes the instruction
+    uint16_t pc;                // address of the first byte
+    uint16_t imm;               // immediate operand n or nn, relative jump e
+    int8_t disp;                // displacement d of (IX+d) and (IY+d)
+    uint8_t prefix;             // 0, 0xCB, 0xDD, 0xED, 0xFD
+    uint8_t op;                 // opcode byte that selected the handler
+    uint8_t len;                // length in bytes
+    uint8_t m;                  // M cycles when no branch is taken
+    uint8_t t;                  // T states when no branch is taken
+    uint8_t refresh;            // number of M1 cycles, R is incremented by it
+};
+
+void resetZ80(void);
+void emuZ80(void);
+void emuZ80Trace(void);
+void setFlags(void);
+
+// z80flags.c
+extern const uint8_t flagTableSZ53[256];
+extern const uint8_t flagTableSZ53P[256];
+extern const uint8_t flagTableInc[256];
+extern const uint8_t flagTableDec[256];
+extern const uint16_t flagTableDaa[2048];
+
+// z80fast.c
+void decodeZ80(uint16_t pc, z80insn *in);
+void stepZ80(void);
+void runZ80(uint32_t clocks);
+void runZ80Switch(uint32_t clocks);
+void runSlices(uint32_t clocks, void (*run)(void));
+void syncFlagsZ80(void);                // F is valid after it, with Z80_LAZY_FLAGS
+
+// z80block.c
+void runZ80Block(uint32_t clocks);
+void flushBlocks(void);
+
+// z80jit.c
+typedef void (*z80code)(void);
+z80code jitBlock(const z80insn *insn, int count, const uint8_t page[2], const uint32_t gen[2]);
+void jitFlush(void);
+int jitFull(void);
+
+// trace.c
+// one record of the binary trace, the file starts with TRACE_MAGIC,
+// TRACE_VERSION and the record size, then the names of the memory map
+// (trace.c), then the records follow in the order of the events
+typedef struct z80trace {
+    uint32_t clocks;            // low 32 bits of MaxClocks at the event
+    uint16_t pc;
+    uint16_t address;           // address bus, or the port of an I/O cycle
+    uint16_t opcode;            // ZOpcode of the half clock engine
+    uint16_t af, bc, de, hl;    // registers of TRACE_REGS
+    uint16_t sp, ix, iy;
+    uint8_t kind;               // TRACE_...
+    uint8_t data;               // data bus
+    uint8_t step;               // Step of the half clock engine
+    uint8_t pins;               // PIN_... of the control signals that are high
+    uint8_t bytes[4];           // instruction of TRACE_INSN for the disassembler
+} z80trace;
+
+#define TRACE_MAGIC     0x5438305A  // "Z80T"
+#define TRACE_VERSION   2
+#define TRACE_NAME      16          // bytes of a page name in the header
+
+enum {
+    TRACE_INSN = 1,             // an instruction starts at pc
+    TRACE_REGS,                 // registers after the instruction
+    TRACE_CLOCK,                // one half clock of emuZ80()
+    TRACE_READ,                 // memory read
+    TRACE_WRITE,                // memory write
+    TRACE_IN,                   // I/O read
+    TRACE_OUT                   // I/O write
+};
+
+#define PIN_CLK         0x01
+#define PIN_M1          0x02
+#define PIN_MREQ        0x04
+#define PIN_RD          0x08
+#define PIN_WR          0x10
+#define PIN_RFSH        0x20
+#define PIN_HALT        0x40
+
+extern uint64_t traceRecords;           // records written to the ring
+extern uint64_t traceStalls;            // records that waited for a full ring
+extern uint64_t traceDropped;           // records the writer could not write
+
+int traceOpen(const char *name);
+void traceClose(void);
+void traceBus(int kind, uint16_t addr, uint8_t value);
+void traceClock(void);
+void traceInsn(void);
+void traceRegs(void);
+
+// statetrace.c
+// file of the CPU states after every instruction, see statetrace.c
+typedef struct z80stateheader {
+    uint32_t magic;             // STATE_MAGIC
+    uint32_t chunks;            // entries of the chunk index
+    uint64_t instructions;      // states in the file
+    uint64_t clocks;            // T states of the run
+    uint64_t index;             // file offset of the chunk index
+} z80stateheader;
+
+typedef struct z80statechunk {
+    uint64_t instruction;       // number of the first state of the chunk
+    uint64_t clocks;            // T states at the first state
+    uint64_t offset;            // file offset of the compressed chunk
+    uint32_t size;              // compressed bytes
+    uint32_t raw;               // bytes after decompression
+} z80statechunk;
+
+#define STATE_MAGIC     0x5338305A  // "Z80S"
+#define STATE_CHUNK     4096        // states in a chunk
+
+// bits of the mask of a state, the registers that changed
+enum {
+    STATE_AF, STATE_BC, STATE_DE, STATE_HL,
+    STATE_AF1, STATE_BC1, STATE_DE1, STATE_HL1,
+    STATE_IX, STATE_IY, STATE_SP,
+    STATE_WORDS,                // 16 bit registers above, 8 bit below
+    STATE_I = STATE_WORDS,
+    STATE_R,                    // R was not incremented by 1
+    STATE_IFF,                  // iff1 | iff2 << 1 | im << 2
+    STATE_REGS
+};
+
+extern int StateTracing;
+
+int stateOpen(const char *name);
+void stateRecord(void);
+void stateClose(void);
+
+// stats.c
+extern int Stats;
+
+#define STATS_COUNT     1               // -c, count the opcodes
+#define STATS_HOST      2               // -p, count them and measure the host time
+
+void statsOpen(const char *name, int mode);
+uint64_t statsHost(void);
+void statsCount(uint32_t opcode, uint32_t cycles, uint32_t clocks, uint32_t waits, uint64_t host);
+void statsInsn(const z80insn *in, uint32_t cycles, uint32_t clocks, uint64_t host);
+int statsWrite(void);
+void statsReport(void);
+void statsPoll(void);
+
+// profile.c
+extern int Profiling;
+
+int profileOpen(const char *name, uint32_t interval);
+void profileInsn(uint16_t pc, uint16_t sp);
+void profileSample(uint16_t pc);
+void profileInterrupt(uint16_t pc, uint16_t vector);
+int profileClose(void);
+
+// cover.c
+// coverage file of z80emu -v, a bit per address in every map
+typedef struct z80cover {
+    uint32_t magic;             // COVER_MAGIC
+    uint8_t start[8192];        // an instruction was executed at the address
+    uint8_t op[8192];           // opcode byte of an executed instruction
+    uint8_t arg[8192];          // operand byte of an executed instruction
+} z80cover;
+
+#define COVER_MAGIC     0x4338305A  // "Z80C"
+
+extern int Covering;
+extern uint8_t coverMap[8192];
+
+// marks the instruction at pc as executed
+#define COVER(pc)       (coverMap[(uint16_t)(pc) >> 3] |= (uint8_t)(1 << ((pc) & 7)))
+
+void coverOpen(const char *name);
+int coverTest(const uint8_t *map, uint16_t addr);
+void coverFill(z80cover *cov);
+int coverLoad(const char *name, z80cover *cov);
+int coverSave(const char *name, const z80cover *cov);
+void coverListing(FILE *fd, const z80cover *cov, uint32_t len);
+int coverClose(uint32_t len);
+
+// heat.c
+enum { HEAT_FETCH, HEAT_READ, HEAT_WRITE, HEAT_KINDS };
+
+extern int Heating;
+extern uint64_t heatMem[HEAT_KINDS][256];   // per 256 byte region
+extern uint64_t heatIo[HEAT_KINDS][256];    // per port, fetch is not used
+
+void heatOpen(const char *name);
+void heatInsn(const z80insn *in);
+int heatClose(void);
+
+// mmu.c
+#define MMU_ROM_MAX     (4 * 1024 * 1024)   // bytes of a ROM image with banks
+
+extern int Banking;
+
+int mmuWindow(const char *spec);
+uint32_t mmuImageSize(size_t size);
+void mmuInit(uint8_t *rom, uint32_t size);
+void mmuOut(uint16_t port, uint8_t value);
+
+// event.c
+typedef void (*z80eventfn)(void *arg, uint32_t value);
+
+extern uint64_t eventNext;
+extern uint64_t runStop;
+
+int eventPost(uint64_t when, z80eventfn fn, void *arg, uint32_t value);
+void eventCancel(z80eventfn fn, void *arg);
+int eventMoves(const uint8_t *pin);
+void eventRun(void);
+int eventPin(uint8_t *pin, uint8_t level, uint64_t when);
+
+// interrupt.c
+#define INT_NMI         0x01            // falling edge of _nmi
+#define INT_IRQ         0x02            // _int is low and IFF1 is set
+#define INT_HALT        0x04            // HALT waits for an interrupt
+
+extern uint8_t intPending;
+
+void intCheck(void);
+void intEnable(void);
+void intHalt(void);
+int intStopped(void);
+int intService(uint64_t stop);
+int intTimer(const char *spec);
+int nmiTimer(const char *spec);
+void intStart(void);
+
+// pace.c
+extern int Pacing;
+
+int paceClock(const char *spec);
+uint32_t paceSlice(void);
+void paceStart(void);
+void paceWait(void);
+void paceReport(void);
+
+// loader.c
+long loadImage(const char *name, long addr, uint16_t *start);
+
+// bench.c
+void benchZ80(void);
+
+// disasm.c
+int disasmZ80(uint16_t pc, char *text, int size);
+
+// memory.c
+#define MEM_PAGE        256             // bytes of a page of the memory map
+#define MEM_PAGES       (65536 / MEM_PAGE)
+
+typedef uint8_t (*z80readfn)(uint16_t addr);
+typedef void (*z80writefn)(uint16_t addr, uint8_t value);
+
+// a page of the memory map, see memory.c
+typedef struct z80page {
+    uint8_t *read;              // host memory of the page, NULL: readDevice
+    uint8_t *write;             // host memory for writes, NULL: writeDevice
+    z80readfn readDevice;
+    z80writefn writeDevice;
+    const char *readName;       // for the debug output
+    const char *writeName;
+    uint8_t code;               // writes go to the memory that is read, pageGen
+} z80page;
+
+extern uint8_t rom[32768];
+extern uint8_t ram[32768];
+extern uint8_t vram[32768];
+extern z80page memMap[MEM_PAGES];
+extern uint32_t pageGen[256];
+extern uint64_t memDeviceReads;
+
+uint8_t memFloat(uint16_t addr);
+void memIgnore(uint16_t addr, uint8_t value);
+void memMapMemory(uint16_t addr, uint32_t size, uint8_t *read, uint8_t *write, const char *readName, const char *writeName);
+void memMapDevice(uint16_t addr, uint32_t size, z80readfn read, z80writefn write, const char *name);
+void memSwitch(uint16_t addr, uint32_t size, uint8_t *read);
+void memInit(void);
+
+uint8_t memRead(uint16_t addr);
+uint8_t memFetch(uint16_t addr);
+uint8_t memPeek(uint16_t addr);
+void memWrite(uint16_t addr, uint8_t value);
+void memStore(uint16_t addr, uint8_t value);
+uint8_t ioRead(uint16_t port);
+void ioWrite(uint16_t port, uint8_t value);
+
+#endif
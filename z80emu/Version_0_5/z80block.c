@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Block cache of the instruction level engine
+
+    runZ80Block() decodes a block of instructions once with decodeZ80() and
+    keeps it in a cache indexed by the address of its first instruction.
+    The next time the block is reached the decoded instructions (handler,
+    operands and cost) are executed without reading and decoding the
+    opcodes again.
+
+    A block ends after an unconditional jump, call, return or HALT, after
+    BLOCK_SIZE instructions or when the next instruction starts in a third
+    page. A conditional branch does not end the block, when it is taken
+    the rest of the block is skipped.
+
+    Self modifying code: memWrite() increments the generation of the 256
+    byte page it writes to. A block remembers the generations of its pages
+    when it is decoded and it is decoded again when one of them changed.
+    The generations are also checked after every instruction, so a block
+    that writes into its own code stops after that instruction.
+
+    With Jit a block that was executed JIT_HOT times is translated to host
+    code by z80jit.c. The pages of a translated block that was overwritten
+    JIT_SMC times are not translated again, they hold self modifying code.
+*/
+
+#define BLOCK_SIZE      16              // maximum number of instructions in a block
+#define BLOCK_SLOTS     4096            // blocks in the cache, direct mapped by PC
+#ifndef JIT_HOT
+#define JIT_HOT         64              // executions of a block before it is translated
+#endif
+#define JIT_SMC         4               // translated blocks of a page overwritten
+
+typedef struct z80block {
+    uint16_t pc;                        // address of the first instruction
+    uint8_t count;                      // number of instructions, 0 = empty slot
+    uint8_t page[2];                    // first and last page of the code
+    uint32_t gen[2];                    // generation of the pages when decoded
+    uint32_t hits;                      // executions since it was decoded
+    z80code code;                       // translation, NULL when not translated
+    z80insn insn[BLOCK_SIZE];
+} z80block;
+
+static z80block blocks[BLOCK_SLOTS];
+static uint8_t smcPages[256];           // overwritten translations of a page
+
+// the instruction does not continue with the next one
+static int endsBlock(const z80insn *in) {
+    switch (in->prefix) {
+        case 0:
+            return in->op == 0x18 || in->op == 0x76 || in->op == 0xC3 || in->op == 0xC9 ||
+                   in->op == 0xCD || in->op == 0xE9 || (in->op & 0xC7) == 0xC7;
+        case 0xDD:
+        case 0xFD:
+            return in->op == 0xE9;
+        case 0xED:
+            return (in->op & 0xC7) == 0x45;         // RETN, RETI
+        default:
+            return 0;
+    }
+}
+
+static void decodeBlock(z80block *b, uint16_t pc) {
+    uint16_t last = pc;
+    uint8_t page;
+
+    // the translation of the old block is lost, note self modifying code
+    if (b->code && b->pc == pc && smcPages[b->page[0]] < JIT_SMC) {
+        smcPages[b->page[0]]++;
+        smcPages[b->page[1]]++;
+    }
+
+    b->pc = pc;
+    b->count = 0;
+    b->hits = 0;
+    b->code = NULL;
+    b->page[0] = pc >> 8;
+    do {
+        // stop before the block covers a third page, an instruction has up to 4 bytes
+        page = (uint16_t)(pc + 3) >> 8;
+        if (b->count && page != b->page[0] && page != (uint8_t)(b->page[0] + 1))
+            break;
+        decodeZ80(pc, &b->insn[b->count]);
+        last = pc + b->insn[b->count].len - 1;
+        pc += b->insn[b->count].len;
+    } while (!endsBlock(&b->insn[b->count++]) && b->count < BLOCK_SIZE);
+
+    b->page[1] = last >> 8;
+    b->gen[0] = pageGen[b->page[0]];
+    b->gen[1] = pageGen[b->page[1]];
+}
+
+// forget all blocks and translations, after the ROM was loaded
+void flushBlocks(void) {
+    memset(blocks, 0, sizeof(blocks));
+    memset(smcPages, 0, sizeof(smcPages));
+    jitFlush();
+}
+
+// the blocks up to runStop, a block is not interrupted by an event
+static void runBlocks(void) {
+    while (MaxClocks < runStop) {
+        z80block *b = &blocks[PC & (BLOCK_SLOTS - 1)];
+        const z80insn *in;
+        int n;
+
+        if (b->count == 0 || b->pc != PC ||
+            b->gen[0] != pageGen[b->page[0]] || b->gen[1] != pageGen[b->page[1]])
+            decodeBlock(b, PC);
+
+        if (Jit) {
+            if (b->code) {
+#if Z80_LAZY_FLAGS
+                syncFlagsZ80();
+#endif
+                b->code();
+                continue;
+            }
+            if (++b->hits == JIT_HOT && smcPages[b->page[0]] < JIT_SMC && smcPages[b->page[1]] < JIT_SMC) {
+                b->code = jitBlock(b->insn, b->count, b->page, b->gen);
+                // the code buffer is full, start again with an empty cache
+                if (b->code == NULL && jitFull()) {
+                    flushBlocks();
+                    continue;
+                }
+            }
+        }
+
+        for (in = b->insn, n = b->count; n > 0; in++, n--) {
+            PC += in->len;
+            R = (R & 0x80) | ((R + in->refresh) & 0x7F);
+            COUNT_INSN(in->m, in->t, in->len, in->refresh);
+            in->handler(in);
+
+            // a taken branch, or the code of the block was overwritten
+            if ((uint16_t)PC != (uint16_t)(in->pc + in->len) ||
+                b->gen[0] != pageGen[b->page[0]] || b->gen[1] != pageGen[b->page[1]])
+                break;
+        }
+    }
+}
+
+void runZ80Block(uint32_t clocks) {
+    runSlices(clocks, runBlocks);
+}
@@ -0,0 +1,1661 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Instruction level engine for the Zilog Z80 Processor.
+
+    stepZ80() executes one whole instruction per call. The memory is accessed
+    directly through memRead()/memWrite() instead of driving the bus signals,
+    and the M cycles and T states of the instruction are added at once.
+    Use it when the pin level behaviour of emuZ80() is not needed.
+
+    Decoding is done with one 256 entry table per opcode space:
+        opMain      unprefixed opcodes
+        opCB        CB prefix, rotations and bit operations
+        opED        ED prefix, miscellaneous instructions
+        opDD, opFD  DD and FD prefix, instructions with IX and IY
+        opDDCB      DDCB prefix, bit operations on (IX+d)
+        opFDCB      FDCB prefix, bit operations on (IY+d)
+    decodeZ80() reads the prefix, the opcode and the operands and fills a
+    z80insn with the handler and the fixed cost of the instruction. A handler
+    only adds the extra cycles of a taken branch or of a repeated block
+    instruction.
+*/
+
+// add extra machine cycles and clock states to the counters
+#define CLOCKS(m, t) do { MaxCycles += (m); MaxClocks += (t); } while (0)
+
+// register pairs selected by the 2 bit field of the opcode, 3 is SP
+// (the 8 bit registers of the 3 bit field are REG8() of z80.h)
+static uint16_t *reg16(int p) {
+    return p == 3 ? &SP : &REG16(p);
+}
+
+/*
+    Flags
+*/
+
+// sign, zero and the two undocumented bits of a result, the tables are in z80flags.c
+static inline uint8_t flagsSZ53(uint8_t v) {
+    return flagTableSZ53[v];
+}
+
+static inline uint8_t flagsSZ53P(uint8_t v) {
+    return flagTableSZ53P[v];
+}
+
+/*
+    Flags of the 8 bit arithmetic and logic instructions
+
+    flagsOf() computes F from the kind of the operation and its operands.
+    Normally the flags are computed at once. With Z80_LAZY_FLAGS the
+    operation only records the kind and the operands in lazy, and F is
+    computed the first time it is used. In this file F is then a call to
+    flagsPtr(), so every instruction that reads or writes F gets the
+    computed value. condition() reads Z and C of the recorded operation
+    without computing F.
+*/
+
+enum { FLAGS_DONE, FLAGS_ADD, FLAGS_SUB, FLAGS_CP, FLAGS_AND, FLAGS_LOGIC, FLAGS_INC, FLAGS_DEC };
+
+// a and v are the operands, c is the carry in, or the carry kept by INC and DEC
+static inline uint8_t flagsOf(int kind, uint8_t a, uint8_t v, uint8_t c) {
+    unsigned res;
+    uint8_t r;
+
+    switch (kind) {
+        case FLAGS_ADD:
+            res = a + v + c;
+            r = (uint8_t)res;
+            return flagsSZ53(r) | ((a ^ v ^ r) & FLAG_H) | (((a ^ ~v) & (a ^ r) & 0x80) >> 5) | (res >> 8);
+        case FLAGS_SUB:
+            res = a - v - c;
+            r = (uint8_t)res;
+            return flagsSZ53(r) | ((a ^ v ^ r) & FLAG_H) | (((a ^ v) & (a ^ r) & 0x80) >> 5) | FLAG_N | ((res >> 8) & FLAG_C);
+        case FLAGS_CP:
+            // compare takes the undocumented bits from the operand
+            res = a - v;
+            r = (uint8_t)res;
+            return (r & FLAG_S) | (r ? 0 : FLAG_Z) | (v & (FLAG_5 | FLAG_3)) | ((a ^ v ^ r) & FLAG_H)
+                | (((a ^ v) & (a ^ r) & 0x80) >> 5) | FLAG_N | ((res >> 8) & FLAG_C);
+        case FLAGS_AND:
+            return flagsSZ53P(a) | FLAG_H;
+        case FLAGS_LOGIC:
+            return flagsSZ53P(a);
+        case FLAGS_INC:
+            return c | flagTableInc[(uint8_t)(a + 1)];
+        default:
+            return c | flagTableDec[(uint8_t)(a - 1)];
+    }
+}
+
+#if Z80_LAZY_FLAGS
+
+// the last operation that changed the flags, FLAGS_DONE when F is valid
+static struct {
+    uint8_t kind, a, v, c;
+} lazy;
+
+static uint8_t *flagsPtr(void) {
+    if (lazy.kind != FLAGS_DONE) {
+        F = flagsOf(lazy.kind, lazy.a, lazy.v, lazy.c);
+        lazy.kind = FLAGS_DONE;
+    }
+    return &F;
+}
+
+#undef F
+#define F (*flagsPtr())
+
+#define SET_FLAGS(k, x, y, cy) \
+    do { lazy.kind = (k); lazy.a = (x); lazy.v = (y); lazy.c = (cy); } while (0)
+
+// Z and C of the recorded operation, cc is 0 to 3
+static int lazyCondition(int cc) {
+    unsigned res;
+
+    switch (lazy.kind) {
+        case FLAGS_ADD: res = lazy.a + lazy.v + lazy.c; break;
+        case FLAGS_SUB: res = lazy.a - lazy.v - lazy.c; break;
+        case FLAGS_CP:  res = lazy.a - lazy.v; break;
+        case FLAGS_INC: res = (uint8_t)(lazy.a + 1) | (lazy.c << 8); break;
+        case FLAGS_DEC: res = (uint8_t)(lazy.a - 1) | (lazy.c << 8); break;
+        default:        res = lazy.a; break;
+    }
+    switch (cc) {
+        case 0: return (uint8_t)res != 0;           // NZ
+        case 1: return (uint8_t)res == 0;           // Z
+        case 2: return !((res >> 8) & 1);           // NC
+        default: return (res >> 8) & 1;            // C
+    }
+}
+
+#else
+
+#define SET_FLAGS(k, x, y, cy)      (F = flagsOf((k), (x), (y), (cy)))
+
+#endif
+
+// F computed, for the code outside of this file
+void syncFlagsZ80(void) {
+#if Z80_LAZY_FLAGS
+    flagsPtr();
+#endif
+}
+
+// condition cc of JP cc, JR cc, CALL cc and RET cc
+static int condition(int cc) {
+#if Z80_LAZY_FLAGS
+    if (lazy.kind != FLAGS_DONE && cc < 4)
+        return lazyCondition(cc);
+#endif
+    switch (cc) {
+        case 0: return !(F & FLAG_Z);       // NZ
+        case 1: return F & FLAG_Z;          // Z
+        case 2: return !(F & FLAG_C);       // NC
+        case 3: return F & FLAG_C;          // C
+        case 4: return !(F & FLAG_PV);      // PO
+        case 5: return F & FLAG_PV;         // PE
+        case 6: return !(F & FLAG_S);       // P
+        default: return F & FLAG_S;         // M
+    }
+}
+
+/*
+    Arithmetic and logic
+*/
+
+static void aluAdd(uint8_t v, uint8_t carry) {
+    uint8_t a = A;
+    SET_FLAGS(FLAGS_ADD, a, v, carry);
+    A = a + v + carry;
+}
+
+static void aluSub(uint8_t v, uint8_t carry) {
+    uint8_t a = A;
+    SET_FLAGS(FLAGS_SUB, a, v, carry);
+    A = a - v - carry;
+}
+
+// A is not changed
+static void aluCp(uint8_t v) {
+    SET_FLAGS(FLAGS_CP, (uint8_t)A, v, 0);
+}
+
+static void aluAnd(uint8_t v) {
+    A &= v;
+    SET_FLAGS(FLAGS_AND, (uint8_t)A, 0, 0);
+}
+
+static void aluXor(uint8_t v) {
+    A ^= v;
+    SET_FLAGS(FLAGS_LOGIC, (uint8_t)A, 0, 0);
+}
+
+static void aluOr(uint8_t v) {
+    A |= v;
+    SET_FLAGS(FLAGS_LOGIC, (uint8_t)A, 0, 0);
+}
+
+static void add_a(uint8_t v) { aluAdd(v, 0); }
+static void adc_a(uint8_t v) { aluAdd(v, F & FLAG_C); }
+static void sub_a(uint8_t v) { aluSub(v, 0); }
+static void sbc_a(uint8_t v) { aluSub(v, F & FLAG_C); }
+
+static uint8_t inc8(uint8_t v) {
+    uint8_t carry = F & FLAG_C;
+    SET_FLAGS(FLAGS_INC, v, 0, carry);
+    return v + 1;
+}
+
+static uint8_t dec8(uint8_t v) {
+    uint8_t carry = F & FLAG_C;
+    SET_FLAGS(FLAGS_DEC, v, 0, carry);
+    return v - 1;
+}
+
+static uint16_t add16(uint16_t a, uint16_t v) {
+    uint32_t res = a + v;
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | ((res >> 8) & (FLAG_5 | FLAG_3))
+        | (((a ^ v ^ res) >> 8) & FLAG_H) | (res >> 16);
+    return (uint16_t)res;
+}
+
+static void adcHL(uint16_t v) {
+    uint16_t hl = HL;
+    uint32_t res = hl + v + (F & FLAG_C);
+    uint16_t r = (uint16_t)res;
+    F = ((r >> 8) & (FLAG_S | FLAG_5 | FLAG_3)) | (r ? 0 : FLAG_Z) | (((hl ^ v ^ r) >> 8) & FLAG_H)
+        | (((hl ^ ~v) & (hl ^ r) & 0x8000) >> 13) | (res >> 16);
+    HL = r;
+}
+
+static void sbcHL(uint16_t v) {
+    uint16_t hl = HL;
+    uint32_t res = hl - v - (F & FLAG_C);
+    uint16_t r = (uint16_t)res;
+    F = ((r >> 8) & (FLAG_S | FLAG_5 | FLAG_3)) | (r ? 0 : FLAG_Z) | (((hl ^ v ^ r) >> 8) & FLAG_H)
+        | (((hl ^ v) & (hl ^ r) & 0x8000) >> 13) | FLAG_N | ((res >> 16) & FLAG_C);
+    HL = r;
+}
+
+// RLC, RRC, RL, RR, SLA, SRA, SLL, SRL selected by the 3 bit field of the opcode
+static uint8_t rotate(int op, uint8_t v) {
+    uint8_t c, r;
+
+    switch (op) {
+        case 0: c = v >> 7; r = (v << 1) | c; break;
+        case 1: c = v & 1;  r = (v >> 1) | (c << 7); break;
+        case 2: c = v >> 7; r = (v << 1) | (F & FLAG_C); break;
+        case 3: c = v & 1;  r = (v >> 1) | ((F & FLAG_C) << 7); break;
+        case 4: c = v >> 7; r = v << 1; break;
+        case 5: c = v & 1;  r = (v >> 1) | (v & 0x80); break;
+        case 6: c = v >> 7; r = (v << 1) | 1; break;
+        default: c = v & 1; r = v >> 1; break;
+    }
+    F = flagsSZ53P(r) | c;
+    return r;
+}
+
+// BIT b - the undocumented bits come from f53
+static void bitTest(int b, uint8_t v, uint8_t f53) {
+    uint8_t m = v & (1 << b);
+    F = (F & FLAG_C) | FLAG_H | (f53 & (FLAG_5 | FLAG_3)) | (m ? (m & FLAG_S) : (FLAG_Z | FLAG_PV));
+}
+
+/*
+    Memory and stack
+*/
+
+static uint16_t read16(uint16_t addr) {
+    uint8_t lo = memRead(addr);
+    return (uint16_t)(lo | (memRead(addr + 1) << 8));
+}
+
+static void write16(uint16_t addr, uint16_t value) {
+    memWrite(addr, value & 0xFF);
+    memWrite(addr + 1, value >> 8);
+}
+
+static void push16(uint16_t value) {
+    SP--;
+    memWrite(SP, value >> 8);
+    SP--;
+    memWrite(SP, value & 0xFF);
+}
+
+static uint16_t pop16(void) {
+    uint8_t lo = memRead(SP++);
+    uint8_t hi = memRead(SP++);
+    return (uint16_t)(lo | (hi << 8));
+}
+
+/*
+    Idle loops
+
+    Firmware that waits for an interrupt sits in a loop like JR $, DJNZ $
+    or a loop that polls a flag in RAM (LD A, (flag) / AND A / JR Z, loop)
+    that the interrupt routine sets. In runZ80() and runZ80Switch() such a
+    loop is run up to runStop at once:
+
+    DJNZ $ takes 13 T states for every B down to 1, idleDjnz() counts the
+    rest of them and leaves the last one, with B = 1, to the instruction.
+
+    A taken branch back to an address that is at most IDLE_SPAN bytes
+    before it calls idleLoop(). It keeps a key of the branch: the target,
+    BC, DE, HL and AF and the number of bus cycles that reach a device or
+    change something: writes to memory and I/O, reads of I/O ports and
+    reads of pages without memory (memDeviceReads). When the branch comes
+    again to the same target in the same slice of runSlices() with the
+    same key, the registers and the counters are kept as well. When it
+    then comes once more with all the registers the same and none of these
+    cycles in between, the loop went once around without changing anything
+    and without asking a device. It would do the same until runStop, the
+    memory only changes in the events, so the counters of the round are
+    added for all the rounds that fit before runStop. R is incremented by
+    the M1 cycles of the rounds. A loop that changes a register costs one
+    compare of the key and its store per round. A loop that polls a port
+    with IN or a memory mapped device runs every round, the device sees
+    all its reads.
+
+    stepZ80() and the block cache do not skip anything, the trace and the
+    statistics see every instruction.
+*/
+
+#define IDLE_SPAN       32              // bytes of a poll loop
+
+static int idleSkip;                    // in runZ80() or runZ80Switch()
+static uint32_t idleSlice;              // incremented at every slice of runSlices()
+
+static struct {
+    uint16_t pc;                        // target of the branch
+    uint16_t af;
+    uint32_t slice;                     // idleSlice at the branch
+    uint64_t regs;                      // BC, DE and HL of the bank, and its AF
+    uint64_t bus;                       // writes, I/O reads and device reads
+    int full;                           // the fields below are kept
+    z80counters count;                  // counters at the branch
+    uint8_t all[sizeof(z80.regs)];
+    uint16_t sp, ix, iy;
+    uint8_t bank, bankAF, i;
+} idle;
+
+// adds rounds more rounds of the loop since the branch of idle to the counters and R
+static void idleAdd(uint64_t rounds) {
+    z80counters *c = &z80.count;
+    uint64_t refresh = (c->refresh - idle.count.refresh) * rounds;
+
+    c->instructions += (c->instructions - idle.count.instructions) * rounds;
+    c->cycles += (c->cycles - idle.count.cycles) * rounds;
+    c->fetch += (c->fetch - idle.count.fetch) * rounds;
+    c->memRead += (c->memRead - idle.count.memRead) * rounds;
+    c->clocks += (c->clocks - idle.count.clocks) * rounds;
+    c->refresh += refresh;
+    R = (R & 0x80) | ((R + refresh) & 0x7F);
+}
+
+// a branch was taken back to PC
+static void idleLoop(const z80insn *in) {
+    uint64_t regs, bus = z80.count.memWrite + z80.count.ioWrite + z80.count.ioRead + memDeviceReads;
+    uint16_t af = z80.regs[z80.bankAF].r16[3];
+
+    memcpy(&regs, &z80.regs[z80.bank], sizeof(regs));
+    if (idle.pc != PC || idle.slice != idleSlice || idle.regs != regs || idle.af != af || idle.bus != bus) {
+        if ((uint16_t)(in->pc - PC) > IDLE_SPAN)
+            return;
+        idle.pc = PC;
+        idle.slice = idleSlice;
+        idle.regs = regs;
+        idle.af = af;
+        idle.bus = bus;
+        idle.full = 0;
+        return;
+    }
+
+    syncFlagsZ80();
+    if (idle.full && memcmp(idle.all, z80.regs, sizeof(idle.all)) == 0 && idle.sp == SP &&
+        idle.ix == IX && idle.iy == IY && idle.bank == z80.bank && idle.bankAF == z80.bankAF && idle.i == I) {
+        uint64_t round = MaxClocks - idle.count.clocks;
+        if (runStop > MaxClocks && round > 0)
+            idleAdd((runStop - MaxClocks) / round);
+    }
+    idle.full = 1;
+    idle.count = z80.count;
+    memcpy(idle.all, z80.regs, sizeof(idle.all));
+    idle.sp = SP;
+    idle.ix = IX;
+    idle.iy = IY;
+    idle.bank = z80.bank;
+    idle.bankAF = z80.bankAF;
+    idle.i = I;
+}
+
+// DJNZ $ was taken, B is not 0
+static void idleDjnz(void) {
+    uint64_t rounds = runStop > MaxClocks ? (runStop - MaxClocks) / 13 : 0;
+
+    if (rounds > (uint64_t)(B - 1))
+        rounds = B - 1;
+    B -= (uint8_t)rounds;
+    z80.count.instructions += rounds;
+    z80.count.cycles += 3 * rounds;
+    z80.count.clocks += 13 * rounds;
+    z80.count.fetch += rounds;
+    z80.count.memRead += rounds;
+    z80.count.refresh += rounds;
+    R = (R & 0x80) | ((R + rounds) & 0x7F);
+}
+
+// a taken branch to PC, see idleLoop()
+#define IDLE() do { if (idleSkip && PC <= in->pc) idleLoop(in); } while (0)
+
+/*
+    Unprefixed opcodes
+*/
+
+// LD r, r' - the contents of r' are loaded into r, one handler for all
+// 49 opcodes, the two register fields of the opcode index the register file
+static void op_ld_r_r(const z80insn *in) {
+    REG8((in->op >> 3) & 7) = REG8(in->op & 7);
+}
+
+// LD r, n - loads n into r
+#define LD_R_N(op, dst) \
+    static void op_##op(const z80insn *in) { dst = (uint8_t)in->imm; }
+
+// INC r, DEC r
+#define INC_R(op, r) \
+    static void op_##op(const z80insn *in) { r = inc8(r); }
+#define DEC_R(op, r) \
+    static void op_##op(const z80insn *in) { r = dec8(r); }
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR, CP with a register, (HL) or n
+#define ALU_R(op, func, src) \
+    static void op_##op(const z80insn *in) { func((uint8_t)(src)); }
+
+// JR cc, e - 5 more T states when the jump is taken
+#define JR_CC(op, cc) \
+    static void op_##op(const z80insn *in) { \
+        if (condition(cc)) { PC += (int8_t)in->imm; CLOCKS(1, 5); IDLE(); } }
+
+// JP cc, nn
+#define JP_CC(op, cc) \
+    static void op_##op(const z80insn *in) { if (condition(cc)) { PC = in->imm; IDLE(); } }
+
+// CALL cc, nn - 7 more T states when the call is taken
+#define CALL_CC(op, cc) \
+    static void op_##op(const z80insn *in) { \
+        if (condition(cc)) { push16(PC); PC = in->imm; CLOCKS(2, 7); } }
+
+// RET cc - 6 more T states when the return is taken
+#define RET_CC(op, cc) \
+    static void op_##op(const z80insn *in) { \
+        if (condition(cc)) { PC = pop16(); CLOCKS(2, 6); } }
+
+// RST p - call to a fixed address
+#define RST(op, p) \
+    static void op_##op(const z80insn *in) { push16(PC); PC = p; }
+
+/*
+    Instructions with HL
+
+    HL_FAMILY() writes the handlers of all opcodes that use H, L, HL or
+    (HL). It is expanded three times: for the unprefixed opcodes (op_)
+    with HL, and for the DD (dd_) and FD (fd_) opcodes with IX and IY, so
+    every index instruction has its own handler and never checks which
+    index register it uses.
+
+        p       prefix of the handler names
+        RR      HL, IX or IY
+        RH, RL  H and L, or the halves of the index register
+        M       address of the memory operand, HL or IX+d
+
+    LD r, (IX+d) and LD (IX+d), r use H and L, not the halves of IX. The
+    displacement and the extra M cycles of the index forms come from
+    decodeZ80() and the timing tables.
+*/
+
+#define HL_FAMILY(p, RR, RH, RL, M) \
+    static void p##09(const z80insn *in) { RR = add16(RR, BC); }          /* ADD HL, BC */ \
+    static void p##19(const z80insn *in) { RR = add16(RR, DE); }          /* ADD HL, DE */ \
+    static void p##21(const z80insn *in) { RR = in->imm; }                /* LD HL, nn */ \
+    static void p##22(const z80insn *in) { write16(in->imm, RR); }        /* LD (nn), HL */ \
+    static void p##23(const z80insn *in) { RR++; }                        /* INC HL */ \
+    static void p##24(const z80insn *in) { RH = inc8(RH); }               /* INC H */ \
+    static void p##25(const z80insn *in) { RH = dec8(RH); }               /* DEC H */ \
+    static void p##26(const z80insn *in) { RH = (uint8_t)in->imm; }       /* LD H, n */ \
+    static void p##29(const z80insn *in) { RR = add16(RR, RR); }          /* ADD HL, HL */ \
+    static void p##2A(const z80insn *in) { RR = read16(in->imm); }        /* LD HL, (nn) */ \
+    static void p##2B(const z80insn *in) { RR--; }                        /* DEC HL */ \
+    static void p##2C(const z80insn *in) { RL = inc8(RL); }               /* INC L */ \
+    static void p##2D(const z80insn *in) { RL = dec8(RL); }               /* DEC L */ \
+    static void p##2E(const z80insn *in) { RL = (uint8_t)in->imm; }       /* LD L, n */ \
+    static void p##34(const z80insn *in) {                                /* INC (HL) */ \
+        uint16_t addr = M; \
+        memWrite(addr, inc8(memRead(addr))); } \
+    static void p##35(const z80insn *in) {                                /* DEC (HL) */ \
+        uint16_t addr = M; \
+        memWrite(addr, dec8(memRead(addr))); } \
+    static void p##36(const z80insn *in) { memWrite(M, (uint8_t)in->imm); }/* LD (HL), n */ \
+    static void p##39(const z80insn *in) { RR = add16(RR, SP); }          /* ADD HL, SP */ \
+    static void p##46(const z80insn *in) { B = memRead(M); }              /* LD B, (HL) */ \
+    static void p##4E(const z80insn *in) { C = memRead(M); }              /* LD C, (HL) */ \
+    static void p##56(const z80insn *in) { D = memRead(M); }              /* LD D, (HL) */ \
+    static void p##5E(const z80insn *in) { E = memRead(M); }              /* LD E, (HL) */ \
+    static void p##66(const z80insn *in) { H = memRead(M); }              /* LD H, (HL) */ \
+    static void p##6E(const z80insn *in) { L = memRead(M); }              /* LD L, (HL) */ \
+    static void p##70(const z80insn *in) { memWrite(M, B); }              /* LD (HL), B */ \
+    static void p##71(const z80insn *in) { memWrite(M, C); }              /* LD (HL), C */ \
+    static void p##72(const z80insn *in) { memWrite(M, D); }              /* LD (HL), D */ \
+    static void p##73(const z80insn *in) { memWrite(M, E); }              /* LD (HL), E */ \
+    static void p##74(const z80insn *in) { memWrite(M, H); }              /* LD (HL), H */ \
+    static void p##75(const z80insn *in) { memWrite(M, L); }              /* LD (HL), L */ \
+    static void p##77(const z80insn *in) { memWrite(M, A); }              /* LD (HL), A */ \
+    static void p##7E(const z80insn *in) { A = memRead(M); }              /* LD A, (HL) */ \
+    static void p##84(const z80insn *in) { add_a(RH); }                   /* ADD A, H */ \
+    static void p##85(const z80insn *in) { add_a(RL); }                   /* ADD A, L */ \
+    static void p##86(const z80insn *in) { add_a(memRead(M)); }           /* ADD A, (HL) */ \
+    static void p##8C(const z80insn *in) { adc_a(RH); }                   /* ADC A, H */ \
+    static void p##8D(const z80insn *in) { adc_a(RL); }                   /* ADC A, L */ \
+    static void p##8E(const z80insn *in) { adc_a(memRead(M)); }           /* ADC A, (HL) */ \
+    static void p##94(const z80insn *in) { sub_a(RH); }                   /* SUB H */ \
+    static void p##95(const z80insn *in) { sub_a(RL); }                   /* SUB L */ \
+    static void p##96(const z80insn *in) { sub_a(memRead(M)); }           /* SUB (HL) */ \
+    static void p##9C(const z80insn *in) { sbc_a(RH); }                   /* SBC A, H */ \
+    static void p##9D(const z80insn *in) { sbc_a(RL); }                   /* SBC A, L */ \
+    static void p##9E(const z80insn *in) { sbc_a(memRead(M)); }           /* SBC A, (HL) */ \
+    static void p##A4(const z80insn *in) { aluAnd(RH); }                  /* AND H */ \
+    static void p##A5(const z80insn *in) { aluAnd(RL); }                  /* AND L */ \
+    static void p##A6(const z80insn *in) { aluAnd(memRead(M)); }          /* AND (HL) */ \
+    static void p##AC(const z80insn *in) { aluXor(RH); }                  /* XOR H */ \
+    static void p##AD(const z80insn *in) { aluXor(RL); }                  /* XOR L */ \
+    static void p##AE(const z80insn *in) { aluXor(memRead(M)); }          /* XOR (HL) */ \
+    static void p##B4(const z80insn *in) { aluOr(RH); }                   /* OR H */ \
+    static void p##B5(const z80insn *in) { aluOr(RL); }                   /* OR L */ \
+    static void p##B6(const z80insn *in) { aluOr(memRead(M)); }           /* OR (HL) */ \
+    static void p##BC(const z80insn *in) { aluCp(RH); }                   /* CP H */ \
+    static void p##BD(const z80insn *in) { aluCp(RL); }                   /* CP L */ \
+    static void p##BE(const z80insn *in) { aluCp(memRead(M)); }           /* CP (HL) */ \
+    static void p##E1(const z80insn *in) { RR = pop16(); }                /* POP HL */ \
+    static void p##E3(const z80insn *in) {                                /* EX (SP), HL */ \
+        uint16_t v = read16(SP); \
+        write16(SP, RR); \
+        RR = v; } \
+    static void p##E5(const z80insn *in) { push16(RR); }                  /* PUSH HL */ \
+    static void p##E9(const z80insn *in) { PC = RR; }                     /* JP (HL) */ \
+    static void p##F9(const z80insn *in) { SP = RR; }                     /* LD SP, HL */
+
+HL_FAMILY(op_, HL, H, L, HL)
+
+static void op_00(const z80insn *in) { }                                // NOP
+static void op_01(const z80insn *in) { BC = in->imm; }                  // LD BC, nn
+static void op_02(const z80insn *in) { memWrite(BC, A); }               // LD (BC), A
+static void op_03(const z80insn *in) { BC++; }                          // INC BC
+INC_R(04, B)
+DEC_R(05, B)
+LD_R_N(06, B)
+static void op_07(const z80insn *in) {                                  // RLCA
+    uint8_t a = A;
+    a = (a << 1) | (a >> 7);
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | (a & (FLAG_5 | FLAG_3 | FLAG_C));
+    A = a;
+}
+static void op_08(const z80insn *in) {                                  // EX AF, AF'
+    syncFlagsZ80();
+    z80.bankAF ^= 1;
+}
+static void op_0A(const z80insn *in) { A = memRead(BC); }               // LD A, (BC)
+static void op_0B(const z80insn *in) { BC--; }                          // DEC BC
+INC_R(0C, C)
+DEC_R(0D, C)
+LD_R_N(0E, C)
+static void op_0F(const z80insn *in) {                                  // RRCA
+    uint8_t a = A;
+    uint8_t c = a & 1;
+    a = (a >> 1) | (c << 7);
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | (a & (FLAG_5 | FLAG_3)) | c;
+    A = a;
+}
+
+static void op_10(const z80insn *in) {                                  // DJNZ e
+    if (--B != 0) {
+        PC += (int8_t)in->imm;
+        CLOCKS(1, 5);
+        if (idleSkip && PC == in->pc)
+            idleDjnz();
+    }
+}
+static void op_11(const z80insn *in) { DE = in->imm; }                  // LD DE, nn
+static void op_12(const z80insn *in) { memWrite(DE, A); }               // LD (DE), A
+static void op_13(const z80insn *in) { DE++; }                          // INC DE
+INC_R(14, D)
+DEC_R(15, D)
+LD_R_N(16, D)
+static void op_17(const z80insn *in) {                                  // RLA
+    uint8_t a = A;
+    uint8_t c = a >> 7;
+    a = (a << 1) | (F & FLAG_C);
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | (a & (FLAG_5 | FLAG_3)) | c;
+    A = a;
+}
+static void op_18(const z80insn *in) { PC += (int8_t)in->imm; IDLE(); } // JR e
+static void op_1A(const z80insn *in) { A = memRead(DE); }               // LD A, (DE)
+static void op_1B(const z80insn *in) { DE--; }                          // DEC DE
+INC_R(1C, E)
+DEC_R(1D, E)
+LD_R_N(1E, E)
+static void op_1F(const z80insn *in) {                                  // RRA
+    uint8_t a = A;
+    uint8_t c = a & 1;
+    a = (a >> 1) | ((F & FLAG_C) << 7);
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | (a & (FLAG_5 | FLAG_3)) | c;
+    A = a;
+}
+
+JR_CC(20, 0)                                                            // JR NZ, e
+static void op_27(const z80insn *in) {                                  // DAA
+    uint16_t af = flagTableDaa[(uint8_t)A | (F & (FLAG_C | FLAG_N)) << 8 | (F & FLAG_H) << 6];
+    A = af >> 8;
+    F = (uint8_t)af;
+}
+JR_CC(28, 1)                                                            // JR Z, e
+static void op_2F(const z80insn *in) {                                  // CPL
+    A = ~A;
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV | FLAG_C)) | FLAG_H | FLAG_N | (A & (FLAG_5 | FLAG_3));
+}
+
+JR_CC(30, 2)                                                            // JR NC, e
+static void op_31(const z80insn *in) { SP = in->imm; }                  // LD SP, nn
+static void op_32(const z80insn *in) { memWrite(in->imm, A); }          // LD (nn), A
+static void op_33(const z80insn *in) { SP++; }                          // INC SP
+static void op_37(const z80insn *in) {                                  // SCF
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | (A & (FLAG_5 | FLAG_3)) | FLAG_C;
+}
+JR_CC(38, 3)                                                            // JR C, e
+static void op_3A(const z80insn *in) { A = memRead(in->imm); }          // LD A, (nn)
+static void op_3B(const z80insn *in) { SP--; }                          // DEC SP
+INC_R(3C, A)
+DEC_R(3D, A)
+LD_R_N(3E, A)
+static void op_3F(const z80insn *in) {                                  // CCF
+    uint8_t c = F & FLAG_C;
+    F = (F & (FLAG_S | FLAG_Z | FLAG_PV)) | (A & (FLAG_5 | FLAG_3)) | (c ? FLAG_H : FLAG_C);
+}
+
+static void op_76(const z80insn *in) { intHalt(); }                     // HALT
+
+ALU_R(80, add_a, B)  ALU_R(81, add_a, C)  ALU_R(82, add_a, D)  ALU_R(83, add_a, E)  ALU_R(87, add_a, A)
+ALU_R(88, adc_a, B)  ALU_R(89, adc_a, C)  ALU_R(8A, adc_a, D)  ALU_R(8B, adc_a, E)  ALU_R(8F, adc_a, A)
+ALU_R(90, sub_a, B)  ALU_R(91, sub_a, C)  ALU_R(92, sub_a, D)  ALU_R(93, sub_a, E)  ALU_R(97, sub_a, A)
+ALU_R(98, sbc_a, B)  ALU_R(99, sbc_a, C)  ALU_R(9A, sbc_a, D)  ALU_R(9B, sbc_a, E)  ALU_R(9F, sbc_a, A)
+ALU_R(A0, aluAnd, B) ALU_R(A1, aluAnd, C) ALU_R(A2, aluAnd, D) ALU_R(A3, aluAnd, E) ALU_R(A7, aluAnd, A)
+ALU_R(A8, aluXor, B) ALU_R(A9, aluXor, C) ALU_R(AA, aluXor, D) ALU_R(AB, aluXor, E) ALU_R(AF, aluXor, A)
+ALU_R(B0, aluOr, B)  ALU_R(B1, aluOr, C)  ALU_R(B2, aluOr, D)  ALU_R(B3, aluOr, E)  ALU_R(B7, aluOr, A)
+ALU_R(B8, aluCp, B)  ALU_R(B9, aluCp, C)  ALU_R(BA, aluCp, D)  ALU_R(BB, aluCp, E)  ALU_R(BF, aluCp, A)
+
+RET_CC(C0, 0)                                                           // RET NZ
+static void op_C1(const z80insn *in) { BC = pop16(); }                  // POP BC
+JP_CC(C2, 0)                                                            // JP NZ, nn
+static void op_C3(const z80insn *in) { PC = in->imm; IDLE(); }          // JP nn
+CALL_CC(C4, 0)                                                          // CALL NZ, nn
+static void op_C5(const z80insn *in) { push16(BC); }                    // PUSH BC
+ALU_R(C6, add_a, in->imm)                                               // ADD A, n
+RST(C7, 0x00)
+RET_CC(C8, 1)                                                           // RET Z
+static void op_C9(const z80insn *in) { PC = pop16(); }                  // RET
+JP_CC(CA, 1)                                                            // JP Z, nn
+static void op_CB(const z80insn *in) { }                                // CB prefix, see decodeZ80()
+CALL_CC(CC, 1)                                                          // CALL Z, nn
+static void op_CD(const z80insn *in) { push16(PC); PC = in->imm; }      // CALL nn
+ALU_R(CE, adc_a, in->imm)                                               // ADC A, n
+RST(CF, 0x08)
+
+RET_CC(D0, 2)                                                           // RET NC
+static void op_D1(const z80insn *in) { DE = pop16(); }                  // POP DE
+JP_CC(D2, 2)                                                            // JP NC, nn
+static void op_D3(const z80insn *in) {                                  // OUT (n), A
+    ioWrite((uint16_t)(((uint8_t)A << 8) | (uint8_t)in->imm), A);
+}
+CALL_CC(D4, 2)                                                          // CALL NC, nn
+static void op_D5(const z80insn *in) { push16(DE); }                    // PUSH DE
+ALU_R(D6, sub_a, in->imm)                                               // SUB n
+RST(D7, 0x10)
+RET_CC(D8, 3)                                                           // RET C
+static void op_D9(const z80insn *in) { z80.bank ^= 1; }                 // EXX
+JP_CC(DA, 3)                                                            // JP C, nn
+static void op_DB(const z80insn *in) {                                  // IN A, (n)
+    A = ioRead((uint16_t)(((uint8_t)A << 8) | (uint8_t)in->imm));
+}
+CALL_CC(DC, 3)                                                          // CALL C, nn
+static void op_DD(const z80insn *in) { }                                // DD prefix followed by a prefix acts as NOP
+ALU_R(DE, sbc_a, in->imm)                                               // SBC A, n
+RST(DF, 0x18)
+
+RET_CC(E0, 4)                                                           // RET PO
+JP_CC(E2, 4)                                                            // JP PO, nn
+CALL_CC(E4, 4)                                                          // CALL PO, nn
+ALU_R(E6, aluAnd, in->imm)                                              // AND n
+RST(E7, 0x20)
+RET_CC(E8, 5)                                                           // RET PE
+JP_CC(EA, 5)                                                            // JP PE, nn
+static void op_EB(const z80insn *in) {                                  // EX DE, HL
+    int16_t t = DE;
+    DE = HL;
+    HL = t;
+}
+CALL_CC(EC, 5)                                                          // CALL PE, nn
+static void op_ED(const z80insn *in) { }                                // ED prefix, see decodeZ80()
+ALU_R(EE, aluXor, in->imm)                                              // XOR n
+RST(EF, 0x28)
+
+RET_CC(F0, 6)                                                           // RET P
+static void op_F1(const z80insn *in) {                                  // POP AF
+    uint16_t v = pop16();
+    F = v & 0xFF;
+    A = v >> 8;
+}
+JP_CC(F2, 6)                                                            // JP P, nn
+static void op_F3(const z80insn *in) { z80.iff1 = 0; z80.iff2 = 0; }    // DI
+CALL_CC(F4, 6)                                                          // CALL P, nn
+static void op_F5(const z80insn *in) {                                  // PUSH AF
+    push16((uint16_t)(((uint8_t)A << 8) | F));
+}
+ALU_R(F6, aluOr, in->imm)                                               // OR n
+RST(F7, 0x30)
+RET_CC(F8, 7)                                                           // RET M
+JP_CC(FA, 7)                                                            // JP M, nn
+static void op_FB(const z80insn *in) { intEnable(); }                   // EI
+CALL_CC(FC, 7)                                                          // CALL M, nn
+static void op_FD(const z80insn *in) { }                                // FD prefix followed by a prefix acts as NOP
+ALU_R(FE, aluCp, in->imm)                                               // CP n
+RST(FF, 0x38)
+
+/*
+    CB prefix - rotations, shifts and bit operations
+*/
+
+static void cb_rot_r(const z80insn *in) {
+    uint8_t *r = &REG8(in->op & 7);
+    *r = rotate((in->op >> 3) & 7, *r);
+}
+
+static void cb_rot_hl(const z80insn *in) {
+    memWrite(HL, rotate((in->op >> 3) & 7, memRead(HL)));
+}
+
+static void cb_bit_r(const z80insn *in) {
+    uint8_t v = REG8(in->op & 7);
+    bitTest((in->op >> 3) & 7, v, v);
+}
+
+static void cb_bit_hl(const z80insn *in) {
+    uint8_t v = memRead(HL);
+    bitTest((in->op >> 3) & 7, v, v);
+}
+
+static void cb_res_r(const z80insn *in) {
+    REG8(in->op & 7) &= ~(1 << ((in->op >> 3) & 7));
+}
+
+static void cb_res_hl(const z80insn *in) {
+    memWrite(HL, memRead(HL) & ~(1 << ((in->op >> 3) & 7)));
+}
+
+static void cb_set_r(const z80insn *in) {
+    REG8(in->op & 7) |= 1 << ((in->op >> 3) & 7);
+}
+
+static void cb_set_hl(const z80insn *in) {
+    memWrite(HL, memRead(HL) | (1 << ((in->op >> 3) & 7)));
+}
+
+/*
+    ED prefix - miscellaneous instructions
+*/
+
+// opcodes without an instruction execute as two NOPs
+static void ed_nop(const z80insn *in) { }
+
+static void ed_in_r(const z80insn *in) {                                // IN r, (C)
+    uint8_t v = ioRead(BC);
+    F = (F & FLAG_C) | flagsSZ53P(v);
+    REG8((in->op >> 3) & 7) = v;
+}
+
+static void ed_in_f(const z80insn *in) {                                // IN (C), only the flags are set
+    F = (F & FLAG_C) | flagsSZ53P(ioRead(BC));
+}
+
+static void ed_out_r(const z80insn *in) {                               // OUT (C), r
+    ioWrite(BC, REG8((in->op >> 3) & 7));
+}
+
+static void ed_out_0(const z80insn *in) { ioWrite(BC, 0); }             // OUT (C), 0
+
+static void ed_sbc_hl(const z80insn *in) { sbcHL(*reg16((in->op >> 4) & 3)); }  // SBC HL, rr
+static void ed_adc_hl(const z80insn *in) { adcHL(*reg16((in->op >> 4) & 3)); }  // ADC HL, rr
+
+static void ed_ld_mnn_rr(const z80insn *in) {                           // LD (nn), rr
+    write16(in->imm, *reg16((in->op >> 4) & 3));
+}
+
+static void ed_ld_rr_mnn(const z80insn *in) {                           // LD rr, (nn)
+    *reg16((in->op >> 4) & 3) = read16(in->imm);
+}
+
+static void ed_neg(const z80insn *in) {                                 // NEG
+    uint8_t v = A;
+    A = 0;
+    aluSub(v, 0);
+}
+
+static void ed_retn(const z80insn *in) {                                // RETN
+    z80.iff1 = z80.iff2;
+    PC = pop16();
+    intCheck();
+}
+
+static void ed_reti(const z80insn *in) {                                // RETI
+    z80.iff1 = z80.iff2;
+    PC = pop16();
+    intCheck();
+}
+
+static void ed_im(const z80insn *in) {                                  // IM 0, IM 1, IM 2
+    static const int8_t mode[8] = { 0, 0, 1, 2, 0, 0, 1, 2 };
+    z80.im = mode[(in->op >> 3) & 7];
+}
+
+static void ed_ld_i_a(const z80insn *in) { I = A; }                     // LD I, A
+static void ed_ld_r_a(const z80insn *in) { R = A; }                     // LD R, A
+
+static void ed_ld_a_i(const z80insn *in) {                              // LD A, I
+    A = I;
+    F = (F & FLAG_C) | flagsSZ53(A) | (z80.iff2 ? FLAG_PV : 0);
+}
+
+static void ed_ld_a_r(const z80insn *in) {                              // LD A, R
+    A = R;
+    F = (F & FLAG_C) | flagsSZ53(A) | (z80.iff2 ? FLAG_PV : 0);
+}
+
+static void ed_rrd(const z80insn *in) {                                 // RRD
+    uint8_t v = memRead(HL);
+    uint8_t a = A;
+    memWrite(HL, (uint8_t)((a << 4) | (v >> 4)));
+    A = (a & 0xF0) | (v & 0x0F);
+    F = (F & FLAG_C) | flagsSZ53P(A);
+}
+
+static void ed_rld(const z80insn *in) {                                 // RLD
+    uint8_t v = memRead(HL);
+    uint8_t a = A;
+    memWrite(HL, (uint8_t)((v << 4) | (a & 0x0F)));
+    A = (a & 0xF0) | (v >> 4);
+    F = (F & FLAG_C) | flagsSZ53P(A);
+}
+
+// LDI and LDD, dir is +1 or -1
+static void blockLoad(int dir) {
+    uint8_t v = memRead(HL);
+    uint8_t n;
+    memWrite(DE, v);
+    HL += dir;
+    DE += dir;
+    BC--;
+    n = v + A;
+    F = (F & (FLAG_S | FLAG_Z | FLAG_C)) | (BC ? FLAG_PV : 0) | (n & FLAG_3) | ((n & 0x02) << 4);
+}
+
+// CPI and CPD, returns 1 when A was equal to (HL)
+static int blockCompare(int dir) {
+    uint8_t v = memRead(HL);
+    uint8_t a = A;
+    uint8_t r = a - v;
+    uint8_t h = (a ^ v ^ r) & FLAG_H;
+    uint8_t n = r - (h ? 1 : 0);
+    HL += dir;
+    BC--;
+    F = (F & FLAG_C) | FLAG_N | (r & FLAG_S) | (r ? 0 : FLAG_Z) | h | (BC ? FLAG_PV : 0)
+        | (n & FLAG_3) | ((n & 0x02) << 4);
+    return r == 0;
+}
+
+// flags of INI, IND, OUTI and OUTD, k is the sum used for the carry
+static void blockIoFlags(uint8_t v, unsigned k) {
+    uint8_t b = B;
+    F = flagsSZ53(b) | ((v & 0x80) ? FLAG_N : 0) | (k > 255 ? (FLAG_H | FLAG_C) : 0)
+        | (flagsSZ53P((uint8_t)((k & 7) ^ b)) & FLAG_PV);
+}
+
+static void blockIn(int dir) {
+    uint8_t v = ioRead(BC);
+    memWrite(HL, v);
+    B--;
+    HL += dir;
+    blockIoFlags(v, v + (uint8_t)(C + dir));
+}
+
+static void blockOut(int dir) {
+    uint8_t v = memRead(HL);
+    B--;
+    ioWrite(BC, v);
+    HL += dir;
+    blockIoFlags(v, v + (uint8_t)L);
+}
+
+// the repeated instructions execute again from the same address, 5 more T states
+#define REPEAT() do { PC -= 2; CLOCKS(1, 5); } while (0)
+
+static void ed_ldi(const z80insn *in) { blockLoad(1); }
+static void ed_ldd(const z80insn *in) { blockLoad(-1); }
+static void ed_ldir(const z80insn *in) { blockLoad(1); if (BC) REPEAT(); }
+static void ed_lddr(const z80insn *in) { blockLoad(-1); if (BC) REPEAT(); }
+static void ed_cpi(const z80insn *in) { blockCompare(1); }
+static void ed_cpd(const z80insn *in) { blockCompare(-1); }
+static void ed_cpir(const z80insn *in) { if (!blockCompare(1) && BC) REPEAT(); }
+static void ed_cpdr(const z80insn *in) { if (!blockCompare(-1) && BC) REPEAT(); }
+static void ed_ini(const z80insn *in) { blockIn(1); }
+static void ed_ind(const z80insn *in) { blockIn(-1); }
+static void ed_inir(const z80insn *in) { blockIn(1); if (B) REPEAT(); }
+static void ed_indr(const z80insn *in) { blockIn(-1); if (B) REPEAT(); }
+static void ed_outi(const z80insn *in) { blockOut(1); }
+static void ed_outd(const z80insn *in) { blockOut(-1); }
+static void ed_otir(const z80insn *in) { blockOut(1); if (B) REPEAT(); }
+static void ed_otdr(const z80insn *in) { blockOut(-1); if (B) REPEAT(); }
+
+/*
+    DD and FD prefix - the HL instructions with IX or IY
+
+    Opcodes that do not use H, L or HL run the unprefixed handler. The
+    others are the HL handlers of HL_FAMILY() with IX or IY.
+*/
+
+HL_FAMILY(dd_, IX, IXH, IXL, (uint16_t)(IX + in->disp))
+HL_FAMILY(fd_, IY, IYH, IYL, (uint16_t)(IY + in->disp))
+
+/*
+    DDCB and FDCB prefix - bit operations on (IX+d) and (IY+d)
+
+    Except BIT, the result is also copied into the register selected by
+    the low 3 bits of the opcode when they are not 6.
+*/
+
+#define XYCB_FAMILY(p, M) \
+    static void p##rot(const z80insn *in) { \
+        uint16_t addr = M; \
+        uint8_t v = rotate((in->op >> 3) & 7, memRead(addr)); \
+        memWrite(addr, v); \
+        if ((in->op & 7) != 6) \
+            REG8(in->op & 7) = v; \
+    } \
+    static void p##bit(const z80insn *in) { \
+        uint16_t addr = M; \
+        bitTest((in->op >> 3) & 7, memRead(addr), addr >> 8); \
+    } \
+    static void p##res(const z80insn *in) { \
+        uint16_t addr = M; \
+        uint8_t v = memRead(addr) & ~(1 << ((in->op >> 3) & 7)); \
+        memWrite(addr, v); \
+        if ((in->op & 7) != 6) \
+            REG8(in->op & 7) = v; \
+    } \
+    static void p##set(const z80insn *in) { \
+        uint16_t addr = M; \
+        uint8_t v = memRead(addr) | (1 << ((in->op >> 3) & 7)); \
+        memWrite(addr, v); \
+        if ((in->op & 7) != 6) \
+            REG8(in->op & 7) = v; \
+    }
+
+XYCB_FAMILY(ddcb_, (uint16_t)(IX + in->disp))
+XYCB_FAMILY(fdcb_, (uint16_t)(IY + in->disp))
+
+/*
+    LD r, r' with the halves of IX and IY
+
+    The unprefixed forms with H and L are op_ld_r_r(), with DD and FD
+    they use IXH, IXL, IYH and IYL instead.
+*/
+
+#define XY_LD_FAMILY(p, RH, RL) \
+    static void p##44(const z80insn *in) { B = RH; }                      /* LD B, H */ \
+    static void p##45(const z80insn *in) { B = RL; }                      /* LD B, L */ \
+    static void p##4C(const z80insn *in) { C = RH; }                      /* LD C, H */ \
+    static void p##4D(const z80insn *in) { C = RL; }                      /* LD C, L */ \
+    static void p##54(const z80insn *in) { D = RH; }                      /* LD D, H */ \
+    static void p##55(const z80insn *in) { D = RL; }                      /* LD D, L */ \
+    static void p##5C(const z80insn *in) { E = RH; }                      /* LD E, H */ \
+    static void p##5D(const z80insn *in) { E = RL; }                      /* LD E, L */ \
+    static void p##60(const z80insn *in) { RH = B; }                      /* LD H, B */ \
+    static void p##61(const z80insn *in) { RH = C; }                      /* LD H, C */ \
+    static void p##62(const z80insn *in) { RH = D; }                      /* LD H, D */ \
+    static void p##63(const z80insn *in) { RH = E; }                      /* LD H, E */ \
+    static void p##64(const z80insn *in) { }                              /* LD H, H */ \
+    static void p##65(const z80insn *in) { RH = RL; }                     /* LD H, L */ \
+    static void p##67(const z80insn *in) { RH = A; }                      /* LD H, A */ \
+    static void p##68(const z80insn *in) { RL = B; }                      /* LD L, B */ \
+    static void p##69(const z80insn *in) { RL = C; }                      /* LD L, C */ \
+    static void p##6A(const z80insn *in) { RL = D; }                      /* LD L, D */ \
+    static void p##6B(const z80insn *in) { RL = E; }                      /* LD L, E */ \
+    static void p##6C(const z80insn *in) { RL = RH; }                     /* LD L, H */ \
+    static void p##6D(const z80insn *in) { }                              /* LD L, L */ \
+    static void p##6F(const z80insn *in) { RL = A; }                      /* LD L, A */ \
+    static void p##7C(const z80insn *in) { A = RH; }                      /* LD A, H */ \
+    static void p##7D(const z80insn *in) { A = RL; }                      /* LD A, L */
+
+XY_LD_FAMILY(dd_, IXH, IXL)
+XY_LD_FAMILY(fd_, IYH, IYL)
+
+/*
+    Decoding tables
+*/
+
+#define ROW(h) \
+    op_##h##0, op_##h##1, op_##h##2, op_##h##3, op_##h##4, op_##h##5, op_##h##6, op_##h##7, \
+    op_##h##8, op_##h##9, op_##h##A, op_##h##B, op_##h##C, op_##h##D, op_##h##E, op_##h##F
+
+// LD r, r' except the columns 6 and E with (HL)
+#define ROW_LD(h) \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_##h##6, op_ld_r_r, \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_##h##E, op_ld_r_r
+
+static const z80handler opMain[256] = {
+    ROW(0), ROW(1), ROW(2), ROW(3), ROW_LD(4), ROW_LD(5), ROW_LD(6),
+    op_70, op_71, op_72, op_73, op_74, op_75, op_76, op_77,
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, op_7E, op_ld_r_r,
+    ROW(8), ROW(9), ROW(A), ROW(B), ROW(C), ROW(D), ROW(E), ROW(F)
+};
+
+// the handlers decode the register and the bit number from the opcode
+static const z80handler opCB[256] = {
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_r, cb_rot_hl, cb_rot_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_r, cb_bit_hl, cb_bit_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_r, cb_res_hl, cb_res_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r,
+    cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_r, cb_set_hl, cb_set_r
+};
+
+static const z80handler opED[256] = {
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_in_r, ed_out_r, ed_sbc_hl, ed_ld_mnn_rr, ed_neg, ed_retn, ed_im, ed_ld_i_a,
+    ed_in_r, ed_out_r, ed_adc_hl, ed_ld_rr_mnn, ed_neg, ed_reti, ed_im, ed_ld_r_a,
+    ed_in_r, ed_out_r, ed_sbc_hl, ed_ld_mnn_rr, ed_neg, ed_retn, ed_im, ed_ld_a_i,
+    ed_in_r, ed_out_r, ed_adc_hl, ed_ld_rr_mnn, ed_neg, ed_retn, ed_im, ed_ld_a_r,
+    ed_in_r, ed_out_r, ed_sbc_hl, ed_ld_mnn_rr, ed_neg, ed_retn, ed_im, ed_rrd,
+    ed_in_r, ed_out_r, ed_adc_hl, ed_ld_rr_mnn, ed_neg, ed_retn, ed_im, ed_rld,
+    ed_in_f, ed_out_0, ed_sbc_hl, ed_ld_mnn_rr, ed_neg, ed_retn, ed_im, ed_nop,
+    ed_in_r, ed_out_r, ed_adc_hl, ed_ld_rr_mnn, ed_neg, ed_retn, ed_im, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_ldi, ed_cpi, ed_ini, ed_outi, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_ldd, ed_cpd, ed_ind, ed_outd, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_ldir, ed_cpir, ed_inir, ed_otir, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_lddr, ed_cpdr, ed_indr, ed_otdr, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop,
+    ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop, ed_nop
+};
+
+// DD and FD opcodes, the unprefixed handler for the opcodes that do not use HL
+#define XY_TABLE(p) { \
+    op_00, op_01, op_02, op_03, op_04, op_05, op_06, op_07, \
+    op_08, p##09, op_0A, op_0B, op_0C, op_0D, op_0E, op_0F, \
+    op_10, op_11, op_12, op_13, op_14, op_15, op_16, op_17, \
+    op_18, p##19, op_1A, op_1B, op_1C, op_1D, op_1E, op_1F, \
+    op_20, p##21, p##22, p##23, p##24, p##25, p##26, op_27, \
+    op_28, p##29, p##2A, p##2B, p##2C, p##2D, p##2E, op_2F, \
+    op_30, op_31, op_32, op_33, p##34, p##35, p##36, op_37, \
+    op_38, p##39, op_3A, op_3B, op_3C, op_3D, op_3E, op_3F, \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, p##44, p##45, p##46, op_ld_r_r, \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, p##4C, p##4D, p##4E, op_ld_r_r, \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, p##54, p##55, p##56, op_ld_r_r, \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, p##5C, p##5D, p##5E, op_ld_r_r, \
+    p##60, p##61, p##62, p##63, p##64, p##65, p##66, p##67, \
+    p##68, p##69, p##6A, p##6B, p##6C, p##6D, p##6E, p##6F, \
+    p##70, p##71, p##72, p##73, p##74, p##75, op_76, p##77, \
+    op_ld_r_r, op_ld_r_r, op_ld_r_r, op_ld_r_r, p##7C, p##7D, p##7E, op_ld_r_r, \
+    op_80, op_81, op_82, op_83, p##84, p##85, p##86, op_87, \
+    op_88, op_89, op_8A, op_8B, p##8C, p##8D, p##8E, op_8F, \
+    op_90, op_91, op_92, op_93, p##94, p##95, p##96, op_97, \
+    op_98, op_99, op_9A, op_9B, p##9C, p##9D, p##9E, op_9F, \
+    op_A0, op_A1, op_A2, op_A3, p##A4, p##A5, p##A6, op_A7, \
+    op_A8, op_A9, op_AA, op_AB, p##AC, p##AD, p##AE, op_AF, \
+    op_B0, op_B1, op_B2, op_B3, p##B4, p##B5, p##B6, op_B7, \
+    op_B8, op_B9, op_BA, op_BB, p##BC, p##BD, p##BE, op_BF, \
+    op_C0, op_C1, op_C2, op_C3, op_C4, op_C5, op_C6, op_C7, \
+    op_C8, op_C9, op_CA, op_CB, op_CC, op_CD, op_CE, op_CF, \
+    op_D0, op_D1, op_D2, op_D3, op_D4, op_D5, op_D6, op_D7, \
+    op_D8, op_D9, op_DA, op_DB, op_DC, op_DD, op_DE, op_DF, \
+    op_E0, p##E1, op_E2, p##E3, op_E4, p##E5, op_E6, op_E7, \
+    op_E8, p##E9, op_EA, op_EB, op_EC, op_ED, op_EE, op_EF, \
+    op_F0, op_F1, op_F2, op_F3, op_F4, op_F5, op_F6, op_F7, \
+    op_F8, p##F9, op_FA, op_FB, op_FC, op_FD, op_FE, op_FF \
+}
+
+static const z80handler opDD[256] = XY_TABLE(dd_);
+static const z80handler opFD[256] = XY_TABLE(fd_);
+
+#define XYCB_TABLE(p) { \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, p##rot, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, p##bit, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##res, p##res, p##res, p##res, p##res, p##res, p##res, p##res, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set, \
+    p##set, p##set, p##set, p##set, p##set, p##set, p##set, p##set \
+}
+
+static const z80handler opDDCB[256] = XYCB_TABLE(ddcb_);
+static const z80handler opFDCB[256] = XYCB_TABLE(fdcb_);
+
+// T states and M cycles of the opcode spaces, the branches not taken
+static const uint8_t tMain[256] = {
+     4, 10,  7,  6,  4,  4,  7,  4,  4, 11,  7,  6,  4,  4,  7,  4,
+     8, 10,  7,  6,  4,  4,  7,  4, 12, 11,  7,  6,  4,  4,  7,  4,
+     7, 10, 16,  6,  4,  4,  7,  4,  7, 11, 16,  6,  4,  4,  7,  4,
+     7, 10, 13,  6, 11, 11, 10,  4,  7, 11, 13,  6,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     7,  7,  7,  7,  7,  7,  4,  7,  4,  4,  4,  4,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+     5, 10, 10, 10, 10, 11,  7, 11,  5, 10, 10,  0, 10, 17,  7, 11,
+     5, 10, 10, 11, 10, 11,  7, 11,  5,  4, 10, 11, 10,  0,  7, 11,
+     5, 10, 10, 19, 10, 11,  7, 11,  5,  4, 10,  4, 10,  0,  7, 11,
+     5, 10, 10,  4, 10, 11,  7, 11,  5,  6, 10,  4, 10,  0,  7, 11
+};
+
+static const uint8_t mMain[256] = {
+     1,  3,  2,  1,  1,  1,  2,  1,  1,  3,  2,  1,  1,  1,  2,  1,
+     2,  3,  2,  1,  1,  1,  2,  1,  3,  3,  2,  1,  1,  1,  2,  1,
+     2,  3,  5,  1,  1,  1,  2,  1,  2,  3,  5,  1,  1,  1,  2,  1,
+     2,  3,  4,  1,  3,  3,  3,  1,  2,  3,  4,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     2,  2,  2,  2,  2,  2,  1,  2,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,
+     1,  3,  3,  3,  3,  3,  2,  3,  1,  3,  3,  0,  3,  5,  2,  3,
+     1,  3,  3,  3,  3,  3,  2,  3,  1,  1,  3,  3,  3,  0,  2,  3,
+     1,  3,  3,  5,  3,  3,  2,  3,  1,  1,  3,  1,  3,  0,  2,  3,
+     1,  3,  3,  1,  3,  3,  2,  3,  1,  1,  3,  1,  3,  0,  2,  3
+};
+
+// number of operand bytes after the opcode
+static const uint8_t lenMain[256] = {
+     0,  2,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     1,  2,  0,  0,  0,  0,  1,  0,  1,  0,  0,  0,  0,  0,  1,  0,
+     1,  2,  2,  0,  0,  0,  1,  0,  1,  0,  2,  0,  0,  0,  1,  0,
+     1,  2,  2,  0,  0,  0,  1,  0,  1,  0,  2,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  2,  2,  2,  0,  1,  0,  0,  0,  2,  0,  2,  2,  1,  0,
+     0,  0,  2,  1,  2,  0,  1,  0,  0,  0,  2,  1,  2,  0,  1,  0,
+     0,  0,  2,  0,  2,  0,  1,  0,  0,  0,  2,  0,  2,  0,  1,  0,
+     0,  0,  2,  0,  2,  0,  1,  0,  0,  0,  2,  0,  2,  0,  1,  0
+};
+
+static const uint8_t tCB[256] = {
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+     8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+     8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+     8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
+     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8
+};
+
+static const uint8_t mCB[256] = {
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  3,  2,  2,  2,  2,  2,  2,  2,  3,  2,
+     2,  2,  2,  2,  2,  2,  3,  2,  2,  2,  2,  2,  2,  2,  3,  2,
+     2,  2,  2,  2,  2,  2,  3,  2,  2,  2,  2,  2,  2,  2,  3,  2,
+     2,  2,  2,  2,  2,  2,  3,  2,  2,  2,  2,  2,  2,  2,  3,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2,
+     2,  2,  2,  2,  2,  2,  4,  2,  2,  2,  2,  2,  2,  2,  4,  2
+};
+
+static const uint8_t tED[256] = {
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+    12, 12, 15, 20,  8, 14,  8,  9, 12, 12, 15, 20,  8, 14,  8,  9,
+    12, 12, 15, 20,  8, 14,  8,  9, 12, 12, 15, 20,  8, 14,  8,  9,
+    12, 12, 15, 20,  8, 14,  8, 18, 12, 12, 15, 20,  8, 14,  8, 18,
+    12, 12, 15, 20,  8, 14,  8,  8, 12, 12, 15, 20,  8, 14,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+    16, 16, 16, 16,  8,  8,  8,  8, 16, 16, 16, 16,  8,  8,  8,  8,
+    16, 16, 16, 16,  8,  8,  8,  8, 16, 16, 16, 16,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,
+     8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8,  8
+};
+
+static const uint8_t mED[256] = {
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     3,  3,  4,  6,  2,  4,  2,  2,  3,  3,  4,  6,  2,  4,  2,  2,
+     3,  3,  4,  6,  2,  4,  2,  2,  3,  3,  4,  6,  2,  4,  2,  2,
+     3,  3,  4,  6,  2,  4,  2,  5,  3,  3,  4,  6,  2,  4,  2,  5,
+     3,  3,  4,  6,  2,  4,  2,  2,  3,  3,  4,  6,  2,  4,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     4,  4,  4,  4,  2,  2,  2,  2,  4,  4,  4,  4,  2,  2,  2,  2,
+     4,  4,  4,  4,  2,  2,  2,  2,  4,  4,  4,  4,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2
+};
+
+// ED instructions with a 16 bit address operand
+static const uint8_t lenED[256] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  2,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,  0,
+     0,  0,  0,  2,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,  0,
+     0,  0,  0,  2,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,  0,
+     0,  0,  0,  2,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+// DD and FD add 4 T states, (IX+d) needs the displacement and the address calculation
+static const uint8_t tXY[256] = {
+     8, 14, 11, 10,  8,  8, 11,  8,  8, 15, 11, 10,  8,  8, 11,  8,
+    12, 14, 11, 10,  8,  8, 11,  8, 16, 15, 11, 10,  8,  8, 11,  8,
+    11, 14, 20, 10,  8,  8, 11,  8, 11, 15, 20, 10,  8,  8, 11,  8,
+    11, 14, 17, 10, 23, 23, 19,  8, 11, 15, 17, 10,  8,  8, 11,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+    19, 19, 19, 19, 19, 19,  8, 19,  8,  8,  8,  8,  8,  8, 19,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+     8,  8,  8,  8,  8,  8, 19,  8,  8,  8,  8,  8,  8,  8, 19,  8,
+     9, 14, 14, 14, 14, 15, 11, 15,  9, 14, 14,  4, 14, 21, 11, 15,
+     9, 14, 14, 15, 14, 15, 11, 15,  9,  8, 14, 15, 14,  4, 11, 15,
+     9, 14, 14, 23, 14, 15, 11, 15,  9,  8, 14,  8, 14,  4, 11, 15,
+     9, 14, 14,  8, 14, 15, 11, 15,  9, 10, 14,  8, 14,  4, 11, 15
+};
+
+static const uint8_t mXY[256] = {
+     2,  4,  3,  2,  2,  2,  3,  2,  2,  4,  3,  2,  2,  2,  3,  2,
+     3,  4,  3,  2,  2,  2,  3,  2,  4,  4,  3,  2,  2,  2,  3,  2,
+     3,  4,  6,  2,  2,  2,  3,  2,  3,  4,  6,  2,  2,  2,  3,  2,
+     3,  4,  5,  2,  6,  6,  5,  2,  3,  4,  5,  2,  2,  2,  3,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     5,  5,  5,  5,  5,  5,  2,  5,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  2,  2,  2,  2,  2,  5,  2,  2,  2,  2,  2,  2,  2,  5,  2,
+     2,  4,  4,  4,  4,  4,  3,  4,  2,  4,  4,  1,  4,  6,  3,  4,
+     2,  4,  4,  4,  4,  4,  3,  4,  2,  2,  4,  4,  4,  1,  3,  4,
+     2,  4,  4,  6,  4,  4,  3,  4,  2,  2,  4,  2,  4,  1,  3,  4,
+     2,  4,  4,  2,  4,  4,  3,  4,  2,  2,  4,  2,  4,  1,  3,  4
+};
+
+// opcodes that read a displacement d after the DD or FD opcode
+static const uint8_t dispXY[256] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  1,  1,  1,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     1,  1,  1,  1,  1,  1,  0,  1,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  0,  0,  1,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+// the DDCB and FDCB forms, BIT b, (IX+d) is shorter
+#define T_XYCB(op)  (((op) & 0xC0) == 0x40 ? 20 : 23)
+#define M_XYCB(op)  (((op) & 0xC0) == 0x40 ? 5 : 6)
+
+void decodeZ80(uint16_t pc, z80insn *in) {
+    uint8_t op = memFetch(pc);
+    uint8_t len;
+
+    in->pc = pc;
+    in->imm = 0;
+    in->disp = 0;
+
+    switch (op) {
+        case 0xCB:
+            op = memFetch(pc + 1);
+            in->handler = opCB[op];
+            in->prefix = 0xCB;
+            in->op = op;
+            in->len = 2;
+            in->m = mCB[op];
+            in->t = tCB[op];
+            in->refresh = 2;
+            return;
+
+        case 0xED:
+            op = memFetch(pc + 1);
+            in->handler = opED[op];
+            in->prefix = 0xED;
+            in->op = op;
+            if (lenED[op])
+                in->imm = (uint16_t)(memFetch(pc + 2) | (memFetch(pc + 3) << 8));
+            in->len = 2 + lenED[op];
+            in->m = mED[op];
+            in->t = tED[op];
+            in->refresh = 2;
+            return;
+
+        case 0xDD:
+        case 0xFD:
+            in->prefix = op;
+            op = memFetch(pc + 1);
+            if (op == 0xDD || op == 0xED || op == 0xFD) {
+                // the prefix is ignored, the next one starts a new instruction
+                in->handler = opMain[in->prefix];
+                in->op = in->prefix;
+                in->prefix = 0;
+                in->len = 1;
+                in->m = 1;
+                in->t = 4;
+                in->refresh = 1;
+                return;
+            }
+            if (op == 0xCB) {
+                in->disp = (int8_t)memFetch(pc + 2);
+                op = memFetch(pc + 3);
+                in->handler = (in->prefix == 0xDD) ? opDDCB[op] : opFDCB[op];
+                in->op = op;
+                in->len = 4;
+                in->m = M_XYCB(op);
+                in->t = T_XYCB(op);
+                in->refresh = 2;
+                return;
+            }
+            in->handler = (in->prefix == 0xDD) ? opDD[op] : opFD[op];
+            in->op = op;
+            pc += 2;
+            if (dispXY[op])
+                in->disp = (int8_t)memFetch(pc++);
+            len = lenMain[op];
+            if (len == 1)
+                in->imm = memFetch(pc);
+            else if (len == 2)
+                in->imm = (uint16_t)(memFetch(pc) | (memFetch(pc + 1) << 8));
+            in->len = 2 + dispXY[op] + len;
+            in->m = mXY[op];
+            in->t = tXY[op];
+            in->refresh = 2;
+            return;
+
+        default:
+            in->handler = opMain[op];
+            in->prefix = 0;
+            in->op = op;
+            len = lenMain[op];
+            if (len == 1)
+                in->imm = memFetch(pc + 1);
+            else if (len == 2)
+                in->imm = (uint16_t)(memFetch(pc + 1) | (memFetch(pc + 2) << 8));
+            in->len = 1 + len;
+            in->m = mMain[op];
+            in->t = tMain[op];
+            in->refresh = 1;
+            return;
+    }
+}
+
+void stepZ80(void) {
+    z80insn in;
+    uint64_t cycles = MaxCycles, clocks = MaxClocks;
+    uint64_t host = Stats == STATS_HOST ? statsHost() : 0;
+
+    if (DEBUG(1)) {
+        char text[32];
+        disasmZ80(PC, text, sizeof(text));
+        if (DEBUG(7))
+            printf("\n\nPC = 0x%04X -- %s", PC, text);
+        else
+            printf("\n\n%s", text);
+    }
+    if (TRACING)
+        traceInsn();
+
+    decodeZ80(PC, &in);
+    PC += in.len;
+    R = (R & 0x80) | ((R + in.refresh) & 0x7F);
+    COUNT_INSN(in.m, in.t, in.len, in.refresh);
+    in.handler(&in);
+    if (Stats)
+        statsInsn(&in, MaxCycles - cycles, MaxClocks - clocks, Stats == STATS_HOST ? statsHost() - host : 0);
+    if (Heating)
+        heatInsn(&in);
+
+    if (DEBUG(8))
+        printf(" ==> A=0x%02X, F=0x%02X, BC=0x%04X, DE=0x%04X, HL=0x%04X, SP=0x%04X, IX=0x%04X, IY=0x%04X",
+               (uint8_t)A, F, (uint16_t)BC, (uint16_t)DE, (uint16_t)HL, (uint16_t)SP, IX, IY);
+    if (TRACING)
+        traceRegs();
+    if (MaxClocks >= eventNext)
+        eventRun();
+}
+
+/*
+    Run loops
+
+    runZ80() executes instructions until the given number of T states has
+    passed, or until a HALT that no interrupt can end (interrupt.c). The
+    only test between two instructions is the one of runStop. The unprefixed opcodes are expanded in place, so the
+    compiler inlines the handler and folds the operand length and the cost
+    for every opcode. The prefixed opcodes go through decodeZ80().
+
+    With Z80_THREADED every opcode ends with its own indirect jump to the
+    code of the next opcode (labels as values of GCC and Clang) instead of
+    returning to one central switch. runZ80Switch() is the fallback for the
+    other compilers and is always built, for the benchmark.
+*/
+
+#define OPROW(X, h) \
+    X(h##0) X(h##1) X(h##2) X(h##3) X(h##4) X(h##5) X(h##6) X(h##7) \
+    X(h##8) X(h##9) X(h##A) X(h##B) X(h##C) X(h##D) X(h##E) X(h##F)
+
+// LD r, r' is LD(h), the other opcodes X(h)
+#define OPROW_LD(X, LD, h) \
+    LD(h##0) LD(h##1) LD(h##2) LD(h##3) LD(h##4) LD(h##5) X(h##6) LD(h##7) \
+    LD(h##8) LD(h##9) LD(h##A) LD(h##B) LD(h##C) LD(h##D) X(h##E) LD(h##F)
+
+#define OPCODES(X, LD) \
+    OPROW(X, 0) OPROW(X, 1) OPROW(X, 2) OPROW(X, 3) OPROW_LD(X, LD, 4) OPROW_LD(X, LD, 5) OPROW_LD(X, LD, 6) \
+    X(70) X(71) X(72) X(73) X(74) X(75) X(76) X(77) \
+    LD(78) LD(79) LD(7A) LD(7B) LD(7C) LD(7D) X(7E) LD(7F) \
+    OPROW(X, 8) OPROW(X, 9) OPROW(X, A) OPROW(X, B) OPROW(X, C) OPROW(X, D) OPROW(X, E) OPROW(X, F)
+
+#define IS_PREFIX(op) ((op) == 0xCB || (op) == 0xDD || (op) == 0xED || (op) == 0xFD)
+
+// execute the instruction at PC that starts with opcode code, function is its op_XX handler
+// (the hex digits are pasted by the caller, BC or DE alone would expand to registers)
+#define EXECUTE(code, function) \
+    if (IS_PREFIX(code)) { \
+        decodeZ80(PC, &in); \
+        PC += in.len; \
+        R = (R & 0x80) | ((R + in.refresh) & 0x7F); \
+        COUNT_INSN(in.m, in.t, in.len, in.refresh); \
+        in.handler(&in); \
+    } \
+    else { \
+        in.pc = PC; \
+        in.op = code; \
+        if (lenMain[code] == 1) \
+            in.imm = memFetch(PC + 1); \
+        else if (lenMain[code] == 2) \
+            in.imm = (uint16_t)(memFetch(PC + 1) | (memFetch(PC + 2) << 8)); \
+        PC += 1 + lenMain[code]; \
+        R = (R & 0x80) | ((R + 1) & 0x7F); \
+        COUNT_INSN(mMain[code], tMain[code], 1 + lenMain[code], 1); \
+        function(&in); \
+    }
+
+#define SWITCH_CASE(h)  case 0x##h: EXECUTE(0x##h, op_##h) break;
+#define SWITCH_LD(h)    case 0x##h: EXECUTE(0x##h, op_ld_r_r) break;
+
+// runs clocks T states in slices of run() that end at runStop, the events
+// and the interrupts are taken between them
+void runSlices(uint32_t clocks, void (*run)(void)) {
+    uint64_t end = MaxClocks + clocks;
+
+    while (MaxClocks < end) {
+        runStop = eventNext < end ? eventNext : end;
+        idleSlice++;
+        if (intPending) {
+            if (intStopped())
+                return;
+            intService(runStop);
+        }
+        run();
+        if (MaxClocks >= eventNext)
+            eventRun();
+    }
+}
+
+static void runSwitch(void) {
+    z80insn in = { 0 };
+
+    while (MaxClocks < runStop) {
+        switch (memFetch(PC)) {
+            OPCODES(SWITCH_CASE, SWITCH_LD)
+        }
+    }
+}
+
+void runZ80Switch(uint32_t clocks) {
+    idleSkip = 1;
+    runSlices(clocks, runSwitch);
+    idleSkip = 0;
+}
+
+#if Z80_THREADED
+
+#define LABEL_ADDRESS(h)  &&L_##h,
+
+// every opcode checks the limit and jumps to the next opcode by itself
+#define THREADED_CASE(h) \
+    L_##h: \
+    EXECUTE(0x##h, op_##h) \
+    if (MaxClocks >= runStop) \
+        return; \
+    goto *label[memFetch(PC)];
+
+#define THREADED_LD(h) \
+    L_##h: \
+    EXECUTE(0x##h, op_ld_r_r) \
+    if (MaxClocks >= runStop) \
+        return; \
+    goto *label[memFetch(PC)];
+
+static void runThreaded(void) {
+    static void *const label[256] = { OPCODES(LABEL_ADDRESS, LABEL_ADDRESS) };
+    z80insn in = { 0 };
+
+    if (MaxClocks >= runStop)
+        return;
+    goto *label[memFetch(PC)];
+
+    OPCODES(THREADED_CASE, THREADED_LD)
+}
+
+void runZ80(uint32_t clocks) {
+    idleSkip = 1;
+    runSlices(clocks, runThreaded);
+    idleSkip = 0;
+}
+
+#else
+
+void runZ80(uint32_t clocks) {
+    runZ80Switch(clocks);
+}
+
+#endif
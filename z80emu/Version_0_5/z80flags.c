@@ -0,0 +1,61 @@
+#include <stdint.h>
+
+#include "z80.h"
+
+/*
+    Flag tables of the instruction level engine
+
+    The tables are constant expressions expanded by the preprocessor, the
+    compiler puts them into the read only data. Nothing is computed at
+    startup and a flag result is one load.
+
+        flagTableSZ53     S, Z, 5 and 3 of a result
+        flagTableSZ53P    the same and P/V as parity (logic, rotate, IN)
+        flagTableInc      flags of INC r from the result, without carry
+        flagTableDec      flags of DEC r from the result, without carry
+        flagTableDaa      A << 8 | F after DAA, indexed by A | C << 8 | N << 9 | H << 10
+*/
+
+// 16 and 256 entries of a table, h are the leading hex digits of the index
+#define ROW16(X, h) \
+    X(h##0) X(h##1) X(h##2) X(h##3) X(h##4) X(h##5) X(h##6) X(h##7) \
+    X(h##8) X(h##9) X(h##A) X(h##B) X(h##C) X(h##D) X(h##E) X(h##F)
+
+#define ROW256(X, h) \
+    ROW16(X, h##0) ROW16(X, h##1) ROW16(X, h##2) ROW16(X, h##3) \
+    ROW16(X, h##4) ROW16(X, h##5) ROW16(X, h##6) ROW16(X, h##7) \
+    ROW16(X, h##8) ROW16(X, h##9) ROW16(X, h##A) ROW16(X, h##B) \
+    ROW16(X, h##C) ROW16(X, h##D) ROW16(X, h##E) ROW16(X, h##F)
+
+// 0x6996 has a bit set for every 4 bit value with odd parity
+#define PARITY(v)   (((0x6996 >> (((v) ^ ((v) >> 4)) & 0x0F)) & 1) ? 0 : FLAG_PV)
+#define SZ53(v)     (((v) & (FLAG_S | FLAG_5 | FLAG_3)) | ((v) ? 0 : FLAG_Z))
+#define SZ53P(v)    (SZ53(v) | PARITY(v))
+
+#define INC(v)      (SZ53(v) | (((v) & 0x0F) ? 0 : FLAG_H) | ((v) == 0x80 ? FLAG_PV : 0))
+#define DEC(v)      (SZ53(v) | (((v) & 0x0F) == 0x0F ? FLAG_H : 0) | ((v) == 0x7F ? FLAG_PV : 0) | FLAG_N)
+
+// DAA: the correction is subtracted after SUB and added after ADD
+#define DAA_A(i)    ((i) & 0xFF)
+#define DAA_CY(i)   (((i) & 0x100) || DAA_A(i) > 0x99)
+#define DAA_DIFF(i) ((((i) & 0x400) || (DAA_A(i) & 0x0F) > 9 ? 0x06 : 0) | (DAA_CY(i) ? 0x60 : 0))
+#define DAA_R(i)    ((((i) & 0x200) ? DAA_A(i) - DAA_DIFF(i) : DAA_A(i) + DAA_DIFF(i)) & 0xFF)
+#define DAA_H(i)    (((i) & 0x200) ? (((i) & 0x400) && (DAA_A(i) & 0x0F) < 6) : ((DAA_A(i) & 0x0F) > 9))
+#define DAA(i)      (DAA_R(i) << 8 | SZ53P(DAA_R(i)) | ((i) & 0x200 ? FLAG_N : 0) \
+                    | (DAA_H(i) ? FLAG_H : 0) | (DAA_CY(i) ? FLAG_C : 0))
+
+#define SZ53_ENTRY(v)   SZ53(v),
+#define SZ53P_ENTRY(v)  SZ53P(v),
+#define INC_ENTRY(v)    INC(v),
+#define DEC_ENTRY(v)    DEC(v),
+#define DAA_ENTRY(i)    DAA(i),
+
+const uint8_t flagTableSZ53[256] = { ROW256(SZ53_ENTRY, 0x) };
+const uint8_t flagTableSZ53P[256] = { ROW256(SZ53P_ENTRY, 0x) };
+const uint8_t flagTableInc[256] = { ROW256(INC_ENTRY, 0x) };
+const uint8_t flagTableDec[256] = { ROW256(DEC_ENTRY, 0x) };
+
+const uint16_t flagTableDaa[2048] = {
+    ROW256(DAA_ENTRY, 0x0) ROW256(DAA_ENTRY, 0x1) ROW256(DAA_ENTRY, 0x2) ROW256(DAA_ENTRY, 0x3)
+    ROW256(DAA_ENTRY, 0x4) ROW256(DAA_ENTRY, 0x5) ROW256(DAA_ENTRY, 0x6) ROW256(DAA_ENTRY, 0x7)
+};
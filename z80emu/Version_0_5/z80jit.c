@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "z80.h"
+
+/*
+    Translator of hot blocks to x86-64 code
+
+    jitBlock() gets a block decoded by z80block.c and writes native code
+    for it. While the block runs A, BC, DE and HL are kept in host
+    registers; they are written back to z80 before an instruction that is
+    not translated and at every exit of the block:
+
+        A = AL    B = BH    C = BL    D = DH    E = DL    H = CH    L = CL
+
+    R15 points to z80, R14 to the current bank of BC, DE and HL and R13
+    to the current bank of A and F (z80.regs). F, SP and the other
+    registers stay in memory. The banks are read again after every
+    handler, EXX and EX AF,AF' only flip the bank index.
+
+    Translated instructions: LD r,r', LD r,n, LD rr,nn, INC rr, DEC rr,
+    EX DE,HL, INC r, DEC r, AND, OR and XOR with a register or n, DJNZ,
+    JR, JP and the conditional JR and JP. Every other instruction calls
+    its handler of z80fast.c with a copy of the decoded instruction, so
+    the two engines always compute the same result. With Z80_LAZY_FLAGS
+    the flags are computed with syncFlagsZ80() after every handler.
+
+    The M cycles, T states, R and the counters of the translated
+    instructions are added up while translating and written at the exits
+    and before a handler is called, so at the end of a block the state is
+    the same as after runZ80Block() without the translator.
+
+    A block is not translated when it uses I/O instructions. After a
+    handler call the generations of the pages of the block are compared,
+    if the block wrote into its own code it exits at the next instruction.
+
+    Only built for x86-64 with GCC or Clang on Linux, jitBlock() returns
+    NULL on other hosts and the block cache is used without it.
+*/
+
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__)
+
+#include <sys/mman.h>
+
+#define JIT_SIZE        (4 * 1024 * 1024)   // bytes of code for all blocks
+#define JIT_MAX_BLOCK   8192                // more than the largest block translation
+
+static uint8_t *jitBase;        // code buffer
+static uint8_t *jitPtr;         // next free byte
+static int jitFailed;           // no executable memory, translation is disabled
+
+// host register of B, C, D, E, H, L, (HL), A
+static const uint8_t hostReg[8] = { 7, 3, 6, 2, 5, 1, 0xFF, 0 };
+
+// cost of the translated instructions that is not written to z80 yet
+typedef struct {
+    uint32_t m, t, r, n;        // M cycles, T states, R increment (M1 cycles), instructions
+    uint32_t o;                 // operand bytes, memory read cycles
+} jitCost;
+
+static jitCost pend;
+
+static uint8_t *p;              // write pointer while translating
+
+static void emit8(uint8_t v)  { *p++ = v; }
+static void emit16(uint16_t v) { memcpy(p, &v, 2); p += 2; }
+static void emit32(uint32_t v) { memcpy(p, &v, 4); p += 4; }
+static void emit64(uint64_t v) { memcpy(p, &v, 8); p += 8; }
+
+// offset of a field of z80 from R15
+static uint32_t offset(const void *field) {
+    return (uint32_t)((const uint8_t *)field - (const uint8_t *)&z80);
+}
+
+static void jitInit(void) {
+    jitBase = mmap(NULL, JIT_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jitBase == MAP_FAILED) {
+        jitBase = NULL;
+        jitFailed = 1;
+        if (DEBUG(1))
+            printf("\nNo executable memory, the translator is disabled");
+        return;
+    }
+    jitPtr = jitBase;
+}
+
+// R15 relative operand: mod 10, rm 111, disp32
+static void modrm15(uint8_t reg, const void *field) {
+    emit8(0x80 | (reg << 3) | 7);
+    emit32(offset(field));
+}
+
+// bank relative operand: mod 01, rm 101 (R13, A and F) or 110 (R14, BC, DE and HL), disp8
+#define BANK_AF     5
+#define BANK_REGS   6
+#define SLOT_A      6
+#define SLOT_F      7
+
+static void modrmBank(uint8_t reg, uint8_t base, uint8_t slot) {
+    emit8(0x40 | (reg << 3) | base);
+    emit8(slot);
+}
+
+static void spill(void) {
+    emit8(0x41); emit8(0x88); modrmBank(0, BANK_AF, SLOT_A);            // mov [A], al
+    emit8(0x66); emit8(0x41); emit8(0x89); modrmBank(3, BANK_REGS, 0);  // mov [BC], bx
+    emit8(0x66); emit8(0x41); emit8(0x89); modrmBank(2, BANK_REGS, 2);  // mov [DE], dx
+    emit8(0x66); emit8(0x41); emit8(0x89); modrmBank(1, BANK_REGS, 4);  // mov [HL], cx
+}
+
+// R14 and R13 from the bank indexes, then the registers
+static void reload(void) {
+    emit8(0x41); emit8(0x0F); emit8(0xB6); modrm15(6, &z80.bank);       // movzx esi, [bank]
+    emit8(0xC1); emit8(0xE6); emit8(0x03);                              // shl esi, 3
+    emit8(0x4D); emit8(0x8D); emit8(0xB4); emit8(0x37);                 // lea r14, [r15 + rsi + regs]
+    emit32(offset(z80.regs));
+    emit8(0x41); emit8(0x0F); emit8(0xB6); modrm15(6, &z80.bankAF);     // movzx esi, [bankAF]
+    emit8(0xC1); emit8(0xE6); emit8(0x03);                              // shl esi, 3
+    emit8(0x4D); emit8(0x8D); emit8(0xAC); emit8(0x37);                 // lea r13, [r15 + rsi + regs]
+    emit32(offset(z80.regs));
+
+    emit8(0x41); emit8(0x8A); modrmBank(0, BANK_AF, SLOT_A);            // mov al, [A]
+    emit8(0x66); emit8(0x41); emit8(0x8B); modrmBank(3, BANK_REGS, 0);  // mov bx, [BC]
+    emit8(0x66); emit8(0x41); emit8(0x8B); modrmBank(2, BANK_REGS, 2);  // mov dx, [DE]
+    emit8(0x66); emit8(0x41); emit8(0x8B); modrmBank(1, BANK_REGS, 4);  // mov cx, [HL]
+}
+
+#define EPILOGUE_SIZE   12
+
+static void epilogue(void) {
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(0x08);         // add rsp, 8
+    emit8(0x41); emit8(0x5D);                                   // pop r13
+    emit8(0x41); emit8(0x5E);                                   // pop r14
+    emit8(0x41); emit8(0x5F);                                   // pop r15
+    emit8(0x5B);                                                // pop rbx
+    emit8(0xC3);                                                // ret
+}
+
+// add v to a 64 bit counter of z80.count
+static void addCounter(uint64_t *counter, uint32_t v) {
+    if (v) {
+        emit8(0x49); emit8(0x81); modrm15(0, counter); emit32(v);      // add qword [counter], v
+    }
+}
+
+// write the cost of the instructions since the last flush, plus m and t
+static void flush(uint32_t m, uint32_t t) {
+    addCounter(&MaxCycles, m + pend.m);
+    addCounter(&MaxClocks, t + pend.t);
+    addCounter(&MaxInstrictions, pend.n);
+    addCounter(&z80.count.fetch, pend.r);
+    addCounter(&z80.count.refresh, pend.r);
+    addCounter(&z80.count.memRead, pend.o);
+    if (pend.r & 0x7F) {
+        // R = (R & 0x80) | ((R + r) & 0x7F)
+        emit8(0x41); emit8(0x0F); emit8(0xB6); modrm15(6, &R);      // movzx esi, [R]
+        emit8(0x89); emit8(0xF7);                                   // mov edi, esi
+        emit8(0x81); emit8(0xE6); emit32(0x80);                     // and esi, 80h
+        emit8(0x81); emit8(0xC7); emit32(pend.r & 0x7F);            // add edi, r
+        emit8(0x81); emit8(0xE7); emit32(0x7F);                     // and edi, 7Fh
+        emit8(0x09); emit8(0xFE);                                   // or esi, edi
+        emit8(0x41); emit8(0x88); modrm15(6, &R);                   // mov [R], sil
+    }
+    memset(&pend, 0, sizeof(pend));
+}
+
+static void storePC(uint16_t pc) {
+    emit8(0x66); emit8(0x41); emit8(0xC7); modrm15(0, &PC); emit16(pc);    // mov [PC], pc
+}
+
+// leave the block at pc, m and t are the extra cost of a taken branch,
+// the code after it continues with the same pending cost
+static void exitBlock(uint16_t pc, uint32_t m, uint32_t t) {
+    jitCost saved = pend;
+
+    flush(m, t);
+    storePC(pc);
+    spill();
+    epilogue();
+    pend = saved;
+}
+
+// F = (F & keep) | table[reg]
+static void emitFlags(uint8_t reg, const uint8_t *table, uint8_t keep) {
+    emit8(0x0F); emit8(0xB6); emit8(0xC0 | (6 << 3) | reg);            // movzx esi, reg
+    emit8(0x48); emit8(0xBF); emit64((uintptr_t)table);                 // mov rdi, table
+    emit8(0x0F); emit8(0xB6); emit8(0x34); emit8(0x37);                 // movzx esi, [rdi + rsi]
+    if (keep) {
+        emit8(0x41); emit8(0x80); modrmBank(4, BANK_AF, SLOT_F); emit8(keep);    // and [F], keep
+        emit8(0x41); emit8(0x08); modrmBank(6, BANK_AF, SLOT_F);        // or [F], sil
+    }
+    else {
+        emit8(0x41); emit8(0x88); modrmBank(6, BANK_AF, SLOT_F);        // mov [F], sil
+    }
+}
+
+// conditional branch on cc, the code of the taken branch is written by
+// the caller and skipped with the returned rel32 when the condition is false
+static uint8_t *branchIf(int cc) {
+    static const uint8_t mask[4] = { FLAG_Z, FLAG_C, FLAG_PV, FLAG_S };
+    uint8_t *rel;
+
+    emit8(0x41); emit8(0xF6); modrmBank(0, BANK_AF, SLOT_F); emit8(mask[cc >> 1]);    // test [F], mask
+    // NZ, NC, PO and P are taken when the flag is 0
+    emit8(0x0F); emit8((cc & 1) ? 0x84 : 0x85);                         // jz / jnz not taken
+    rel = p;
+    emit32(0);
+    return rel;
+}
+
+static void patch(uint8_t *rel) {
+    uint32_t d = (uint32_t)(p - (rel + 4));
+    memcpy(rel, &d, 4);
+}
+
+// check the result of a handler: leave when PC is not the next instruction
+// or when the code of the block was overwritten
+static void checkExit(uint16_t next, const uint8_t page[2], const uint32_t gen[2]) {
+    int i;
+
+    emit8(0x66); emit8(0x41); emit8(0x81); modrm15(7, &PC); emit16(next);  // cmp [PC], next
+    emit8(0x74); emit8(EPILOGUE_SIZE);                                      // je over the epilogue
+    epilogue();
+    for (i = 0; i < 2; i++) {
+        if (i == 1 && page[1] == page[0])
+            break;
+        emit8(0x48); emit8(0xBE); emit64((uintptr_t)&pageGen[page[i]]);     // mov rsi, &pageGen[page]
+        emit8(0x81); emit8(0x3E); emit32(gen[i]);                           // cmp [rsi], gen
+        emit8(0x74); emit8(EPILOGUE_SIZE);                                  // je over the epilogue
+        epilogue();
+    }
+}
+
+// translate one unprefixed instruction: 0 when it needs its handler,
+// 1 when it continues with the next instruction, 2 when it left the block
+static int translate(const z80insn *in) {
+    uint8_t op = in->op;
+    uint8_t n = (uint8_t)in->imm;
+    uint16_t next = in->pc + in->len;
+    uint16_t target = next + (int8_t)in->imm;
+    uint8_t *rel;
+    int x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+
+    if (in->prefix != 0)
+        return 0;
+
+    // a branch to the next instruction does not leave the block in
+    // runZ80Block(), the handler adds the cost of the taken branch
+    if ((op == 0x10 || (op & 0xE7) == 0x20) && target == next)
+        return 0;
+    if ((op & 0xC7) == 0xC2 && in->imm == next)
+        return 0;
+
+    // LD r, r'
+    if (x == 1 && y != 6 && z != 6) {
+        if (y != z) {
+            emit8(0x88); emit8(0xC0 | (hostReg[z] << 3) | hostReg[y]);
+        }
+        return 1;
+    }
+    // LD r, n
+    if (x == 0 && z == 6 && y != 6) {
+        emit8(0xB0 + hostReg[y]); emit8(n);
+        return 1;
+    }
+    // AND, XOR, OR with a register
+    if (x == 2 && z != 6 && (y == 4 || y == 5 || y == 6)) {
+        static const uint8_t code[3] = { 0x20, 0x30, 0x08 };
+        emit8(code[y - 4]); emit8(0xC0 | (hostReg[z] << 3));
+        emitFlags(0, flagTableSZ53P, 0);
+        if (y == 4) {
+            emit8(0x41); emit8(0x80); modrmBank(1, BANK_AF, SLOT_F); emit8(FLAG_H);    // or [F], H
+        }
+        return 1;
+    }
+    // INC r, DEC r
+    if (x == 0 && (z == 4 || z == 5) && y != 6) {
+        emit8(0xFE); emit8((z == 4 ? 0xC0 : 0xC8) | hostReg[y]);
+        emitFlags(hostReg[y], z == 4 ? flagTableInc : flagTableDec, FLAG_C);
+        return 1;
+    }
+    // JR cc, e
+    if (x == 0 && z == 0 && y >= 4) {
+        rel = branchIf(y - 4);
+        exitBlock(target, 1, 5);
+        patch(rel);
+        return 1;
+    }
+    // JP cc, nn
+    if (x == 3 && z == 2) {
+        rel = branchIf(y);
+        exitBlock(in->imm, 0, 0);
+        patch(rel);
+        return 1;
+    }
+
+    switch (op) {
+        case 0x00:                                                          // NOP
+            break;
+        case 0x01: emit8(0x66); emit8(0xBB); emit16(in->imm); break;        // LD BC, nn
+        case 0x11: emit8(0x66); emit8(0xBA); emit16(in->imm); break;        // LD DE, nn
+        case 0x21: emit8(0x66); emit8(0xB9); emit16(in->imm); break;        // LD HL, nn
+        case 0x31: emit8(0x66); emit8(0x41); emit8(0xC7); modrm15(0, &SP); emit16(in->imm); break;
+        case 0x03: emit8(0x66); emit8(0xFF); emit8(0xC3); break;            // INC BC
+        case 0x13: emit8(0x66); emit8(0xFF); emit8(0xC2); break;            // INC DE
+        case 0x23: emit8(0x66); emit8(0xFF); emit8(0xC1); break;            // INC HL
+        case 0x33: emit8(0x66); emit8(0x41); emit8(0xFF); modrm15(0, &SP); break;
+        case 0x0B: emit8(0x66); emit8(0xFF); emit8(0xCB); break;            // DEC BC
+        case 0x1B: emit8(0x66); emit8(0xFF); emit8(0xCA); break;            // DEC DE
+        case 0x2B: emit8(0x66); emit8(0xFF); emit8(0xC9); break;            // DEC HL
+        case 0x3B: emit8(0x66); emit8(0x41); emit8(0xFF); modrm15(1, &SP); break;
+        case 0xEB: emit8(0x66); emit8(0x87); emit8(0xD1); break;            // EX DE, HL
+        case 0xE6: emit8(0x24); emit8(n); emitFlags(0, flagTableSZ53P, 0);    // AND n
+                   emit8(0x41); emit8(0x80); modrmBank(1, BANK_AF, SLOT_F); emit8(FLAG_H); break;
+        case 0xEE: emit8(0x34); emit8(n); emitFlags(0, flagTableSZ53P, 0); break;    // XOR n
+        case 0xF6: emit8(0x0C); emit8(n); emitFlags(0, flagTableSZ53P, 0); break;    // OR n
+        case 0x10:                                                          // DJNZ e
+            emit8(0xFE); emit8(0xCF);                                       // dec bh
+            emit8(0x0F); emit8(0x84);                                       // jz not taken
+            rel = p;
+            emit32(0);
+            exitBlock(target, 1, 5);
+            patch(rel);
+            break;
+        case 0x18: exitBlock(target, 0, 0); return 2;                       // JR e
+        case 0xC3: exitBlock(in->imm, 0, 0); return 2;                      // JP nn
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+// instructions that read or write I/O ports
+static int usesIO(const z80insn *in) {
+    if (in->prefix == 0)
+        return in->op == 0xDB || in->op == 0xD3;
+    if (in->prefix == 0xED)
+        return (in->op & 0xC6) == 0x40 || (in->op & 0xE6) == 0xA2;
+    return 0;
+}
+
+z80code jitBlock(const z80insn *insn, int count, const uint8_t page[2], const uint32_t gen[2]) {
+    z80insn *copy;
+    uint8_t *code;
+    int i;
+
+    if (jitBase == NULL && !jitFailed)
+        jitInit();
+    if (jitFailed)
+        return NULL;
+
+    for (i = 0; i < count; i++)
+        if (usesIO(&insn[i]))
+            return NULL;
+
+    // full, z80block.c flushes the cache
+    if (jitPtr + JIT_MAX_BLOCK > jitBase + JIT_SIZE)
+        return NULL;
+
+    // the handlers get a copy of the instruction that lives with the code
+    copy = (z80insn *)(((uintptr_t)jitPtr + 15) & ~(uintptr_t)15);
+    memcpy(copy, insn, count * sizeof(z80insn));
+    code = (uint8_t *)(((uintptr_t)(copy + count) + 15) & ~(uintptr_t)15);
+    p = code;
+    memset(&pend, 0, sizeof(pend));
+
+    emit8(0x53);                                                // push rbx
+    emit8(0x41); emit8(0x57);                                   // push r15
+    emit8(0x41); emit8(0x56);                                   // push r14
+    emit8(0x41); emit8(0x55);                                   // push r13
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(0x08);         // sub rsp, 8
+    emit8(0x49); emit8(0xBF); emit64((uintptr_t)&z80);          // mov r15, &z80
+    reload();
+
+    for (i = 0; i < count; i++) {
+        const z80insn *in = &copy[i];
+        uint16_t next = in->pc + in->len;
+        int last = (i == count - 1);
+
+        pend.m += in->m;
+        pend.t += in->t;
+        pend.r += in->refresh;
+        pend.n++;
+        pend.o += in->len - in->refresh;
+
+        switch (translate(in)) {
+            case 1:
+                if (last)
+                    exitBlock(next, 0, 0);
+                continue;
+            case 2:
+                continue;
+        }
+
+        // the handler sees the state of stepZ80() before it calls the handler
+        flush(0, 0);
+        storePC(next);
+        spill();
+        emit8(0x48); emit8(0xBF); emit64((uintptr_t)in);                 // mov rdi, in
+        emit8(0x48); emit8(0xB8); emit64((uintptr_t)in->handler);        // mov rax, handler
+        emit8(0xFF); emit8(0xD0);                                        // call rax
+#if Z80_LAZY_FLAGS
+        // the translated instructions use F, it must not be pending
+        emit8(0x48); emit8(0xB8); emit64((uintptr_t)syncFlagsZ80);       // mov rax, syncFlagsZ80
+        emit8(0xFF); emit8(0xD0);                                        // call rax
+#endif
+        reload();
+        checkExit(next, page, gen);
+        if (last) {
+            spill();
+            epilogue();
+        }
+    }
+
+    jitPtr = p;
+    return (z80code)code;
+}
+
+void jitFlush(void) {
+    jitPtr = jitBase;
+}
+
+int jitFull(void) {
+    return jitBase && jitPtr + JIT_MAX_BLOCK > jitBase + JIT_SIZE;
+}
+
+#else
+
+z80code jitBlock(const z80insn *insn, int count, const uint8_t page[2], const uint32_t gen[2]) {
+    return NULL;
+}
+
+void jitFlush(void) {
+}
+
+int jitFull(void) {
+    return 0;
+}
+
+#endif